@@ -13,4 +13,18 @@
 
 #include "ColorRecognition.h"
 
+bool ColorRecognition::fillRGB16(unsigned int buf[3]) {
+    unsigned char rgb[3];
+    bool acquired = fillRGB(rgb);
+    for (unsigned char i = 0; i < 3; i++) {
+        buf[i] = rgb[i] * 257U;
+    }
+    return acquired;
+}
+
+bool ColorRecognition::fillFrequencies(long buf[3]) {
+    buf[0] = buf[1] = buf[2] = 0;
+    return false;
+}
+
 #endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_CPP__ */
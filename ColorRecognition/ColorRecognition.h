@@ -42,6 +42,30 @@ public:
      * @retun               The blue color intensity.
      */
     virtual bool fillRGB(unsigned char buf[3]) = 0;
+
+    /**
+     * Fills the red, green and blue intensities with 16 bits, from 0 to 
+     * 65535, so the resolution of long gates or bright readings is not lost 
+     * to the 8 bits of fillRGB().
+     * 
+     * The default widens fillRGB(), for the drivers that do not measure 
+     * finer than 8 bits.
+     * 
+     * @param buf           The buffer to fill.
+     * @return              If the intensities were acquired.
+     */
+    virtual bool fillRGB16(unsigned int buf[3]);
+
+    /**
+     * Fills the red, green and blue frequencies, in Hz, normalized to the 
+     * 100% scaling and before the white balance.
+     * 
+     * The default does not support it and returns false.
+     * 
+     * @param buf           The buffer to fill.
+     * @return              If the frequencies were acquired.
+     */
+    virtual bool fillFrequencies(long buf[3]);
 };
 
 #endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_H__ */
@@ -0,0 +1,112 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionCalibration.h
+ * 
+ * The calibration and settings of a driver, saved as a record in the EEPROM
+ * so a reset does not need a new calibration.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_CALIBRATION_CPP__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_CALIBRATION_CPP__ 1
+
+#include "ColorRecognitionCalibration.h"
+#include "ColorRecognitionCrc.h"
+#include <EEPROM.h>
+
+/**
+ * The record header.
+ */
+#define CALIBRATION_MAGIC_0 'C'
+#define CALIBRATION_MAGIC_1 'R'
+
+ColorRecognitionCalibration::ColorRecognitionCalibration(unsigned char driver)
+        : driver(driver), options(0) {
+    for (unsigned char i = 0; i < SCALE_CHANNELS; i++) {
+        scalings[i] = 0;
+        gateTimes[i] = 0;
+        blackFrequencies[i] = 0;
+        whiteFrequencies[i] = 0;
+    }
+}
+
+void ColorRecognitionCalibration::setScale(ColorRecognitionScale* scale) {
+    for (unsigned char i = 0; i < SCALE_CHANNELS; i++) {
+        blackFrequencies[i] = scale->getBlack(i);
+        whiteFrequencies[i] = scale->getWhite(i);
+    }
+}
+
+void ColorRecognitionCalibration::applyScale(ColorRecognitionScale* scale) {
+    for (unsigned char i = 0; i < SCALE_CHANNELS; i++) {
+        scale->calibrate(i, blackFrequencies[i], whiteFrequencies[i]);
+    }
+}
+
+void ColorRecognitionCalibration::save(int address) {
+    unsigned int crc = CRC_INITIAL_VALUE;
+    unsigned char header[4] = {CALIBRATION_MAGIC_0, CALIBRATION_MAGIC_1, CALIBRATION_VERSION, driver};
+    unsigned char trailer[2];
+    address = writeBytes(address, header, sizeof(header), &crc);
+    address = writeBytes(address, &options, sizeof(options), &crc);
+    address = writeBytes(address, scalings, sizeof(scalings), &crc);
+    address = writeBytes(address, gateTimes, sizeof(gateTimes), &crc);
+    address = writeBytes(address, blackFrequencies, sizeof(blackFrequencies), &crc);
+    address = writeBytes(address, whiteFrequencies, sizeof(whiteFrequencies), &crc);
+    trailer[0] = crc >> 8;
+    trailer[1] = crc & 0xff;
+    writeBytes(address, trailer, sizeof(trailer), &crc);
+}
+
+bool ColorRecognitionCalibration::load(int address) {
+    ColorRecognitionCalibration record(driver);
+    unsigned int crc = CRC_INITIAL_VALUE;
+    unsigned char header[4];
+    unsigned char trailer[2];
+    address = readBytes(address, header, sizeof(header), &crc);
+    if (header[0] != CALIBRATION_MAGIC_0 || header[1] != CALIBRATION_MAGIC_1 || header[2] != CALIBRATION_VERSION
+            || header[3] != driver) {
+        return false;
+    }
+    address = readBytes(address, &record.options, sizeof(record.options), &crc);
+    address = readBytes(address, record.scalings, sizeof(record.scalings), &crc);
+    address = readBytes(address, record.gateTimes, sizeof(record.gateTimes), &crc);
+    address = readBytes(address, record.blackFrequencies, sizeof(record.blackFrequencies), &crc);
+    address = readBytes(address, record.whiteFrequencies, sizeof(record.whiteFrequencies), &crc);
+    readBytes(address, trailer, sizeof(trailer), &crc);
+    if (crc != 0) {
+        return false;
+    }
+    *this = record;
+    return true;
+}
+
+unsigned int ColorRecognitionCalibration::getSize() {
+    ColorRecognitionCalibration* record = 0;
+    return 4 + sizeof(record->options) + sizeof(record->scalings) + sizeof(record->gateTimes)
+            + sizeof(record->blackFrequencies) + sizeof(record->whiteFrequencies) + 2;
+}
+
+int ColorRecognitionCalibration::writeBytes(int address, const void* data, unsigned int n, unsigned int* crc) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (unsigned int i = 0; i < n; i++, address++) {
+        if (EEPROM.read(address) != bytes[i]) {
+            EEPROM.write(address, bytes[i]);
+        }
+        *crc = ColorRecognitionCrc::update(*crc, bytes[i]);
+    }
+    return address;
+}
+
+int ColorRecognitionCalibration::readBytes(int address, void* data, unsigned int n, unsigned int* crc) {
+    unsigned char* bytes = (unsigned char*) data;
+    for (unsigned int i = 0; i < n; i++, address++) {
+        bytes[i] = EEPROM.read(address);
+        *crc = ColorRecognitionCrc::update(*crc, bytes[i]);
+    }
+    return address;
+}
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_CALIBRATION_CPP__ */
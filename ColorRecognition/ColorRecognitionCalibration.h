@@ -0,0 +1,163 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionCalibration.h
+ * 
+ * The calibration and settings of a driver, saved as a record in the EEPROM
+ * so a reset does not need a new calibration.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_CALIBRATION_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_CALIBRATION_H__ 1
+
+#include <ColorRecognitionScale.h>
+
+/**
+ * The record layout:
+ * 
+ * <pre>
+ * BYTES    FIELD
+ * 2        Magic ('C', 'R')
+ * 1        Version (CALIBRATION_VERSION)
+ * 1        Driver (CALIBRATION_DRIVER_*)
+ * n        Options, scalings, gate times, black and white frequencies
+ * 2        CRC-16/CCITT of all the previous bytes
+ * </pre>
+ * 
+ * A record is only loaded when the magic, the version, the driver and the
+ * CRC match, so an erased EEPROM, a record of an older layout or a save cut
+ * by a reset are all rejected and the sketch falls back to calibrating.
+ * 
+ * Saving only writes the bytes that changed, as each EEPROM cell takes about
+ * 100000 writes and 3.3ms per write. Loading takes well under a millisecond.
+ * 
+ * NOTE: The sketch must include <EEPROM.h> too, so the IDE links the EEPROM
+ * library.
+ */
+
+/**
+ * The version of the record layout. It must be incremented whenever the
+ * fields change.
+ */
+#define CALIBRATION_VERSION 1
+
+/**
+ * The drivers that write records.
+ */
+#define CALIBRATION_DRIVER_TCS230 1
+#define CALIBRATION_DRIVER_TCS230PI 2
+
+/**
+ * The option flags of a record.
+ */
+#define CALIBRATION_AUTO_RANGE 0x01
+#define CALIBRATION_ADAPTIVE_GATE 0x02
+#define CALIBRATION_RGBC_SCHEDULE 0x04
+
+class ColorRecognitionCalibration {
+public:
+
+    /**
+     * The driver the record belongs to.
+     */
+    unsigned char driver;
+
+    /**
+     * The option flags (CALIBRATION_AUTO_RANGE, ...).
+     */
+    unsigned char options;
+
+    /**
+     * The output frequency scaling of each filter.
+     */
+    unsigned char scalings[SCALE_CHANNELS];
+
+    /**
+     * The gate time of each filter, in milliseconds, 0 for the drivers
+     * without gates.
+     */
+    unsigned int gateTimes[SCALE_CHANNELS];
+
+    /**
+     * The black frequency of each filter, in Hz.
+     */
+    long blackFrequencies[SCALE_CHANNELS];
+
+    /**
+     * The white frequency of each filter, in Hz.
+     */
+    long whiteFrequencies[SCALE_CHANNELS];
+
+    /**
+     * Public constructor. The record is cleared.
+     * 
+     * @param driver        The driver the record belongs to.
+     */
+    ColorRecognitionCalibration(unsigned char driver);
+
+    /**
+     * Copies the black and white frequencies of a scale to the record.
+     * 
+     * @param scale         The scale.
+     */
+    void setScale(ColorRecognitionScale* scale);
+
+    /**
+     * Calibrates a scale with the black and white frequencies of the record.
+     * 
+     * @param scale         The scale.
+     */
+    void applyScale(ColorRecognitionScale* scale);
+
+    /**
+     * Saves the record to the EEPROM.
+     * 
+     * @param address       The EEPROM address of the record.
+     */
+    void save(int address);
+
+    /**
+     * Loads the record from the EEPROM. The record is left untouched when
+     * the stored one is not valid.
+     * 
+     * @param address       The EEPROM address of the record.
+     * @return              If a valid record of the driver was loaded.
+     */
+    bool load(int address);
+
+    /**
+     * Returns how many EEPROM bytes a record takes.
+     * 
+     * @return              The size, in bytes.
+     */
+    static unsigned int getSize();
+
+private:
+
+    /**
+     * Writes bytes to the EEPROM, skipping the ones that did not change, and
+     * updates the CRC.
+     * 
+     * @param address       The EEPROM address.
+     * @param data          The bytes.
+     * @param n             How many bytes.
+     * @param crc           The CRC to update.
+     * @return              The address after the bytes.
+     */
+    static int writeBytes(int address, const void* data, unsigned int n, unsigned int* crc);
+
+    /**
+     * Reads bytes from the EEPROM and updates the CRC.
+     * 
+     * @param address       The EEPROM address.
+     * @param data          The buffer to fill.
+     * @param n             How many bytes.
+     * @param crc           The CRC to update.
+     * @return              The address after the bytes.
+     */
+    static int readBytes(int address, void* data, unsigned int n, unsigned int* crc);
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_CALIBRATION_H__ */
@@ -0,0 +1,110 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionChangeDetector.h
+ * 
+ * Detects when the color in front of the sensor changes, so the sketch does
+ * not need to poll the intensities.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_CHANGE_DETECTOR_CPP__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_CHANGE_DETECTOR_CPP__ 1
+
+#include "ColorRecognitionChangeDetector.h"
+#include <Arduino.h>
+
+ColorRecognitionChangeDetector::ColorRecognitionChangeDetector(unsigned int threshold, unsigned char frames)
+        : threshold(threshold), changed(false), changes(0), callback(0) {
+    if (frames < 1) {
+        frames = 1;
+    }
+    this->frames = frames;
+    reset();
+}
+
+void ColorRecognitionChangeDetector::setCallback(ChangeCallback callback) {
+    this->callback = callback;
+}
+
+bool ColorRecognitionChangeDetector::update(const long* frequencies, unsigned char channels) {
+    bool deviated = false;
+    long deviation, limit;
+    unsigned char i;
+    if (channels > CHANGE_CHANNELS) {
+        channels = CHANGE_CHANNELS;
+    }
+    if (!primed) {
+        for (i = 0; i < channels; i++) {
+            baseline[i] = frequencies[i];
+        }
+        primed = true;
+        return false;
+    }
+    for (i = 0; i < channels && !deviated; i++) {
+        deviation = frequencies[i] - baseline[i];
+        if (deviation < 0) {
+            deviation = -deviation;
+        }
+        limit = (baseline[i] >> 8) * threshold + (((baseline[i] & 0xff) * threshold) >> 8);
+        if (limit < CHANGE_MIN_DEVIATION) {
+            limit = CHANGE_MIN_DEVIATION;
+        }
+        deviated = deviation > limit;
+    }
+    if (!deviated) {
+        pending = 0;
+        return false;
+    }
+    if (++pending < frames) {
+        return false;
+    }
+    pending = 0;
+    for (i = 0; i < channels; i++) {
+        baseline[i] = frequencies[i];
+    }
+    changes++;
+    changed = true;
+    if (callback != 0) {
+        callback(frequencies);
+    }
+    return true;
+}
+
+bool ColorRecognitionChangeDetector::hasChanged() {
+    bool result;
+    // The flag is tested and cleared at once, so a change confirmed by the
+    // interrupt in between is not lost.
+    noInterrupts();
+    result = changed;
+    changed = false;
+    interrupts();
+    return result;
+}
+
+unsigned long ColorRecognitionChangeDetector::getChangeCount() {
+    unsigned long result;
+    noInterrupts();
+    result = changes;
+    interrupts();
+    return result;
+}
+
+long ColorRecognitionChangeDetector::getBaseline(unsigned char channel) {
+    long result;
+    noInterrupts();
+    result = baseline[channel];
+    interrupts();
+    return result;
+}
+
+void ColorRecognitionChangeDetector::reset() {
+    primed = false;
+    pending = 0;
+    for (unsigned char i = 0; i < CHANGE_CHANNELS; i++) {
+        baseline[i] = 0;
+    }
+}
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_CHANGE_DETECTOR_CPP__ */
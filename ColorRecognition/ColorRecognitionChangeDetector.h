@@ -0,0 +1,168 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionChangeDetector.h
+ * 
+ * Detects when the color in front of the sensor changes, so the sketch does
+ * not need to poll the intensities.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_CHANGE_DETECTOR_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_CHANGE_DETECTOR_H__ 1
+
+/**
+ * The default threshold, in 1/256 of the baseline (32 is 12.5%).
+ */
+#define CHANGE_DEFAULT_THRESHOLD 32
+
+/**
+ * The default number of consecutive frames a change must last.
+ */
+#define CHANGE_DEFAULT_FRAMES 2
+
+/**
+ * The smallest deviation, in Hz at the 100% scaling, taken as a change. It
+ * keeps the noise of the dark channels, where the relative threshold is
+ * only a few Hz, from being taken as changes.
+ */
+#define CHANGE_MIN_DEVIATION 500
+
+/**
+ * The maximum number of channels of a frame.
+ */
+#define CHANGE_CHANNELS 4
+
+/**
+ * How it works:
+ * 
+ * The first frame becomes the baseline. A frame where any channel deviates
+ * from the baseline by more than the threshold is a candidate change, and
+ * when the given number of consecutive frames are candidates, the change is
+ * confirmed: the last frame becomes the new baseline, the changed flag is
+ * raised and the callback is called. A deviation that does not last is
+ * ignored, and as the baseline moves only on confirmed changes, the color
+ * must move again by the threshold for the next event.
+ * 
+ * With the counting driver, the detector runs inside the scheduler
+ * interrupt, so the callback must be short (set a flag, write a pin). The
+ * main loop may sleep in the idle mode, which keeps the interrupts running,
+ * and check hasChanged() when it wakes up.
+ */
+class ColorRecognitionChangeDetector {
+public:
+
+    /**
+     * The change callback.
+     * 
+     * @param frequencies   The frequencies of the frame that confirmed the
+     *                      change, the new baseline.
+     */
+    typedef void (*ChangeCallback)(const long* frequencies);
+
+private:
+
+    /**
+     * The threshold, in 1/256 of the baseline.
+     */
+    unsigned int threshold;
+
+    /**
+     * How many consecutive frames a change must last.
+     */
+    unsigned char frames;
+
+    /**
+     * How many consecutive frames deviated from the baseline.
+     */
+    unsigned char pending;
+
+    /**
+     * Whether the baseline holds a frame.
+     */
+    bool primed;
+
+    /**
+     * Whether a change was confirmed since the last hasChanged().
+     */
+    volatile bool changed;
+
+    /**
+     * How many changes were confirmed.
+     */
+    volatile unsigned long changes;
+
+    /**
+     * The baseline frequencies.
+     */
+    volatile long baseline[CHANGE_CHANNELS];
+
+    /**
+     * The change callback, NULL for none.
+     */
+    ChangeCallback callback;
+
+public:
+
+    /**
+     * Public constructor.
+     * 
+     * @param threshold     The threshold, in 1/256 of the baseline.
+     * @param frames        How many consecutive frames a change must last.
+     */
+    ColorRecognitionChangeDetector(unsigned int threshold = CHANGE_DEFAULT_THRESHOLD,
+            unsigned char frames = CHANGE_DEFAULT_FRAMES);
+
+    /**
+     * Sets the change callback.
+     * 
+     * @param callback      The callback, NULL for none.
+     */
+    void setCallback(ChangeCallback callback);
+
+    /**
+     * Compares a frame to the baseline. It is called by the drivers for each
+     * frame.
+     * 
+     * @param frequencies   The frequencies, in Hz.
+     * @param channels      The number of channels (up to CHANGE_CHANNELS).
+     * @return              If the frame confirmed a change.
+     */
+    bool update(const long* frequencies, unsigned char channels);
+
+    /**
+     * Returns if a change was confirmed since the last call, and clears the
+     * flag.
+     * 
+     * The getters read the detector with the interrupts disabled, since the
+     * interrupt driver updates it from the scheduler interrupt, so they are
+     * not meant for the callback.
+     * 
+     * @return              If the color changed.
+     */
+    bool hasChanged();
+
+    /**
+     * Returns how many changes were confirmed.
+     * 
+     * @return              The number of changes.
+     */
+    unsigned long getChangeCount();
+
+    /**
+     * Returns the baseline of one channel.
+     * 
+     * @param channel       The channel.
+     * @return              The frequency, in Hz.
+     */
+    long getBaseline(unsigned char channel);
+
+    /**
+     * Forgets the baseline, so the next frame becomes the baseline without
+     * being a change.
+     */
+    void reset();
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_CHANGE_DETECTOR_H__ */
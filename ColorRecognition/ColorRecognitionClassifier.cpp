@@ -0,0 +1,172 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionClassifier.h
+ * 
+ * Classifies colors into a palette of reference colors with a precomputed
+ * lookup table.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_CLASSIFIER_CPP__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_CLASSIFIER_CPP__ 1
+
+#include "ColorRecognitionClassifier.h"
+#include <Arduino.h>
+
+ColorRecognitionClassifier::ColorRecognitionClassifier(unsigned char bits)
+        : colorCount(0), table(0), progmemTable(false), buildTime(0) {
+    if (bits < 1) {
+        bits = 1;
+    } else if (bits > 5) {
+        bits = 5;
+    }
+    this->bits = bits;
+    setMaxDistance(CLASSIFIER_DEFAULT_MAX_DISTANCE);
+}
+
+unsigned char ColorRecognitionClassifier::addColor(unsigned char red, unsigned char green, unsigned char blue) {
+    if (colorCount >= CLASSIFIER_MAX_COLORS) {
+        return CLASSIFIER_UNKNOWN;
+    }
+    colors[colorCount][0] = red;
+    colors[colorCount][1] = green;
+    colors[colorCount][2] = blue;
+    return colorCount++;
+}
+
+unsigned char ColorRecognitionClassifier::addColor(ColorRecognition* sensor) {
+    unsigned char rgb[3];
+    sensor->fillRGB(rgb);
+    return addColor(rgb[0], rgb[1], rgb[2]);
+}
+
+void ColorRecognitionClassifier::clear() {
+    colorCount = 0;
+    table = 0;
+}
+
+unsigned char ColorRecognitionClassifier::getColorCount() {
+    return colorCount;
+}
+
+void ColorRecognitionClassifier::setMaxDistance(unsigned long maxDistance) {
+    if (maxDistance == 0) {
+        maxDistance = 1;
+    }
+    this->maxDistance = maxDistance;
+    confidenceFactor = (255UL << 16) / maxDistance;
+}
+
+void ColorRecognitionClassifier::build(unsigned char* buffer) {
+    unsigned long start = micros();
+    unsigned char shift = 8 - bits;
+    unsigned char half = (1 << shift) >> 1;
+    unsigned char cells = 1 << bits;
+    unsigned char rgb[3];
+    unsigned char nearest;
+    unsigned int index = 0;
+    for (unsigned char r = 0; r < cells; r++) {
+        rgb[0] = (r << shift) + half;
+        for (unsigned char g = 0; g < cells; g++) {
+            rgb[1] = (g << shift) + half;
+            for (unsigned char b = 0; b < cells; b++, index++) {
+                rgb[2] = (b << shift) + half;
+                nearest = findNearest(rgb);
+                if (index & 1) {
+                    buffer[index >> 1] |= nearest << 4;
+                } else {
+                    buffer[index >> 1] = nearest;
+                }
+            }
+        }
+    }
+    table = buffer;
+    progmemTable = false;
+    buildTime = micros() - start;
+}
+
+void ColorRecognitionClassifier::setTable(const unsigned char* progmemTable) {
+    table = progmemTable;
+    this->progmemTable = true;
+}
+
+const unsigned char* ColorRecognitionClassifier::getTable() {
+    return table;
+}
+
+unsigned int ColorRecognitionClassifier::getTableSize() {
+    return CLASSIFIER_TABLE_SIZE(bits);
+}
+
+unsigned int ColorRecognitionClassifier::getFootprint() {
+    if (table == 0 || progmemTable) {
+        return sizeof(*this);
+    }
+    return sizeof(*this) + getTableSize();
+}
+
+unsigned long ColorRecognitionClassifier::getBuildTime() {
+    return buildTime;
+}
+
+unsigned char ColorRecognitionClassifier::classify(const unsigned char rgb[3], unsigned char* confidence,
+        unsigned long* distance) {
+    unsigned char shift = 8 - bits;
+    unsigned int index;
+    unsigned char entry, nearest;
+    unsigned long d;
+    if (table == 0) {
+        nearest = findNearest(rgb, &d);
+    } else {
+        index = ((((unsigned int) (rgb[0] >> shift) << bits) | (rgb[1] >> shift)) << bits) | (rgb[2] >> shift);
+        entry = progmemTable ? pgm_read_byte(&table[index >> 1]) : table[index >> 1];
+        nearest = (index & 1) ? (entry >> 4) : (entry & 0x0f);
+        d = (nearest == CLASSIFIER_UNKNOWN) ? maxDistance + 1 : getDistance(rgb, nearest);
+    }
+    if (distance) {
+        *distance = d;
+    }
+    if (d > maxDistance) {
+        if (confidence) {
+            *confidence = 0;
+        }
+        return CLASSIFIER_UNKNOWN;
+    }
+    if (confidence) {
+        *confidence = 255 - (unsigned char) ((d * confidenceFactor) >> 16);
+    }
+    return nearest;
+}
+
+unsigned char ColorRecognitionClassifier::classify(ColorRecognition* sensor, unsigned char* confidence) {
+    unsigned char rgb[3];
+    sensor->fillRGB(rgb);
+    return classify(rgb, confidence);
+}
+
+unsigned char ColorRecognitionClassifier::findNearest(const unsigned char rgb[3], unsigned long* distance) {
+    unsigned char nearest = CLASSIFIER_UNKNOWN;
+    unsigned long best = 0xffffffffUL, d;
+    for (unsigned char i = 0; i < colorCount; i++) {
+        d = getDistance(rgb, i);
+        if (d < best) {
+            best = d;
+            nearest = i;
+        }
+    }
+    if (distance) {
+        *distance = best;
+    }
+    return nearest;
+}
+
+unsigned long ColorRecognitionClassifier::getDistance(const unsigned char rgb[3], unsigned char index) {
+    int dr = (int) rgb[0] - colors[index][0];
+    int dg = (int) rgb[1] - colors[index][1];
+    int db = (int) rgb[2] - colors[index][2];
+    return (unsigned long) ((long) dr * dr) + (unsigned long) ((long) dg * dg) + (unsigned long) ((long) db * db);
+}
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_CLASSIFIER_CPP__ */
@@ -0,0 +1,249 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionClassifier.h
+ * 
+ * Classifies colors into a palette of reference colors with a precomputed
+ * lookup table.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_CLASSIFIER_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_CLASSIFIER_H__ 1
+
+#include <ColorRecognition.h>
+
+/**
+ * How the lookup table works:
+ * 
+ * Each channel is quantized to the given number of bits, and the table holds,
+ * for each quantized cell, the index of the reference color nearest to the
+ * center of the cell. Indexes are 4 bits, two per byte, so with 4 bits per
+ * channel the table has 16x16x16 entries in 2048 bytes, with 3 bits it has
+ * 8x8x8 entries in 256 bytes.
+ * 
+ * A classification is one table read plus the distance to the color found,
+ * which gives the confidence and rejects colors far from all the references.
+ * As the table is built at the center of each cell, colors close to the
+ * boundary between two references may get the second nearest one (about 6%
+ * of random colors for 12 references at 4 bits); findNearest() is exact.
+ * 
+ * The table can be built at run time in a RAM buffer, or built once, printed
+ * and stored in the flash (PROGMEM), which is the way to use the 4 bits table
+ * on boards with 2KB of RAM.
+ */
+
+/**
+ * The maximum number of reference colors. The 16th index marks the unknown
+ * color.
+ */
+#define CLASSIFIER_MAX_COLORS 15
+
+/**
+ * The index returned for colors far from all the references.
+ */
+#define CLASSIFIER_UNKNOWN 15
+
+/**
+ * The default number of bits each channel is quantized to.
+ */
+#define CLASSIFIER_DEFAULT_BITS 4
+
+/**
+ * The size, in bytes, of the table for the given bits per channel.
+ */
+#define CLASSIFIER_TABLE_SIZE(bits) (1U << (3 * (bits) - 1))
+
+/**
+ * The default maximum squared distance of a classified color to its
+ * reference. It is about 64 steps in each channel.
+ */
+#define CLASSIFIER_DEFAULT_MAX_DISTANCE 12288UL
+
+class ColorRecognitionClassifier {
+private:
+
+    /**
+     * The reference colors.
+     */
+    unsigned char colors[CLASSIFIER_MAX_COLORS][3];
+
+    /**
+     * The number of reference colors.
+     */
+    unsigned char colorCount;
+
+    /**
+     * The bits each channel is quantized to.
+     */
+    unsigned char bits;
+
+    /**
+     * The lookup table, NULL until built or set.
+     */
+    const unsigned char* table;
+
+    /**
+     * Whether the table is in the flash.
+     */
+    bool progmemTable;
+
+    /**
+     * The maximum squared distance of a classified color to its reference.
+     */
+    unsigned long maxDistance;
+
+    /**
+     * The reciprocal of the maximum distance, to compute the confidence
+     * without dividing.
+     */
+    unsigned long confidenceFactor;
+
+    /**
+     * How long the last build took, in microseconds.
+     */
+    unsigned long buildTime;
+
+public:
+
+    /**
+     * Public constructor.
+     * 
+     * @param bits          The bits each channel is quantized to (1 to 5).
+     */
+    ColorRecognitionClassifier(unsigned char bits = CLASSIFIER_DEFAULT_BITS);
+
+    /**
+     * Adds a reference color. The table must be built again after it.
+     * 
+     * @param red           The red intensity.
+     * @param green         The green intensity.
+     * @param blue          The blue intensity.
+     * @return              The index of the color, or CLASSIFIER_UNKNOWN if
+     *                      the palette is full.
+     */
+    unsigned char addColor(unsigned char red, unsigned char green, unsigned char blue);
+
+    /**
+     * Adds the color read from a sensor as reference.
+     * 
+     * @param sensor        The sensor.
+     * @return              The index of the color, or CLASSIFIER_UNKNOWN if
+     *                      the palette is full.
+     */
+    unsigned char addColor(ColorRecognition* sensor);
+
+    /**
+     * Removes all the reference colors and the table.
+     */
+    void clear();
+
+    /**
+     * Returns the number of reference colors.
+     * 
+     * @return              The number of colors.
+     */
+    unsigned char getColorCount();
+
+    /**
+     * Sets the maximum squared distance of a classified color to its
+     * reference. Farther colors are classified as CLASSIFIER_UNKNOWN.
+     * 
+     * @param maxDistance   The squared distance (sum of the squared
+     *                      differences of the channels).
+     */
+    void setMaxDistance(unsigned long maxDistance);
+
+    /**
+     * Builds the lookup table of the current reference colors.
+     * 
+     * @param buffer        The table buffer, of CLASSIFIER_TABLE_SIZE(bits)
+     *                      bytes. It must live as long as the classifier.
+     */
+    void build(unsigned char* buffer);
+
+    /**
+     * Uses a table stored in the flash, built with the same reference colors
+     * and bits.
+     * 
+     * @param progmemTable  The table, in PROGMEM.
+     */
+    void setTable(const unsigned char* progmemTable);
+
+    /**
+     * Returns the table, to be printed and stored in the flash.
+     * 
+     * @return              The table, NULL if not built.
+     */
+    const unsigned char* getTable();
+
+    /**
+     * Returns the size of the table.
+     * 
+     * @return              The size, in bytes.
+     */
+    unsigned int getTableSize();
+
+    /**
+     * Returns the RAM the classifier takes, including the table when it is
+     * not in the flash.
+     * 
+     * @return              The size, in bytes.
+     */
+    unsigned int getFootprint();
+
+    /**
+     * Returns how long the last build took.
+     * 
+     * @return              The time, in microseconds.
+     */
+    unsigned long getBuildTime();
+
+    /**
+     * Classifies a color.
+     * 
+     * @param rgb           The red, green and blue intensities.
+     * @param confidence    If not NULL, filled with the confidence, from 0
+     *                      (at the maximum distance) to 255 (the reference
+     *                      itself).
+     * @param distance      If not NULL, filled with the squared distance to
+     *                      the reference.
+     * @return              The index of the color, or CLASSIFIER_UNKNOWN.
+     */
+    unsigned char classify(const unsigned char rgb[3], unsigned char* confidence = 0,
+            unsigned long* distance = 0);
+
+    /**
+     * Reads a sensor and classifies its color.
+     * 
+     * @param sensor        The sensor.
+     * @param confidence    If not NULL, filled with the confidence.
+     * @return              The index of the color, or CLASSIFIER_UNKNOWN.
+     */
+    unsigned char classify(ColorRecognition* sensor, unsigned char* confidence = 0);
+
+    /**
+     * Finds the nearest reference color by comparing all of them, without
+     * the table.
+     * 
+     * @param rgb           The red, green and blue intensities.
+     * @param distance      If not NULL, filled with the squared distance.
+     * @return              The index of the nearest color, or
+     *                      CLASSIFIER_UNKNOWN if there are none.
+     */
+    unsigned char findNearest(const unsigned char rgb[3], unsigned long* distance = 0);
+
+private:
+
+    /**
+     * Returns the squared distance between a color and a reference.
+     * 
+     * @param rgb           The color.
+     * @param index         The index of the reference.
+     * @return              The squared distance.
+     */
+    unsigned long getDistance(const unsigned char rgb[3], unsigned char index);
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_CLASSIFIER_H__ */
@@ -0,0 +1,178 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionColorSpace.h
+ * 
+ * Converts color intensities to HSV and CIE Lab with integer kernels and 
+ * small lookup tables in the flash.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_COLOR_SPACE_CPP__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_COLOR_SPACE_CPP__ 1
+
+#include "ColorRecognitionColorSpace.h"
+#include <Arduino.h>
+
+/**
+ * The sRGB decoding of each 8 bits intensity, in 12 bits linear light.
+ */
+static const unsigned int gammaTable[256] PROGMEM = {
+    0, 1, 2, 4, 5, 6, 7, 9, 10, 11, 12, 14, 15, 16, 18, 20,
+    21, 23, 25, 27, 29, 31, 33, 35, 37, 40, 42, 45, 48, 50, 53, 56,
+    59, 62, 66, 69, 72, 76, 79, 83, 87, 91, 95, 99, 103, 107, 112, 116,
+    121, 126, 131, 136, 141, 146, 151, 156, 162, 168, 173, 179, 185, 191, 197, 204,
+    210, 216, 223, 230, 237, 244, 251, 258, 265, 273, 280, 288, 296, 304, 312, 320,
+    329, 337, 346, 354, 363, 372, 381, 390, 400, 409, 419, 428, 438, 448, 458, 469,
+    479, 490, 500, 511, 522, 533, 544, 555, 567, 578, 590, 602, 614, 626, 639, 651,
+    664, 676, 689, 702, 715, 728, 742, 755, 769, 783, 797, 811, 825, 840, 854, 869,
+    884, 899, 914, 929, 945, 960, 976, 992, 1008, 1024, 1041, 1057, 1074, 1091, 1108, 1125,
+    1142, 1159, 1177, 1195, 1213, 1231, 1249, 1267, 1286, 1304, 1323, 1342, 1361, 1381, 1400, 1420,
+    1440, 1459, 1480, 1500, 1520, 1541, 1562, 1582, 1603, 1625, 1646, 1668, 1689, 1711, 1733, 1755,
+    1778, 1800, 1823, 1846, 1869, 1892, 1916, 1939, 1963, 1987, 2011, 2035, 2059, 2084, 2109, 2133,
+    2159, 2184, 2209, 2235, 2260, 2286, 2312, 2339, 2365, 2392, 2419, 2446, 2473, 2500, 2527, 2555,
+    2583, 2611, 2639, 2668, 2696, 2725, 2754, 2783, 2812, 2841, 2871, 2901, 2931, 2961, 2991, 3022,
+    3052, 3083, 3114, 3146, 3177, 3209, 3240, 3272, 3304, 3337, 3369, 3402, 3435, 3468, 3501, 3535,
+    3568, 3602, 3636, 3670, 3705, 3739, 3774, 3809, 3844, 3879, 3915, 3950, 3986, 4022, 4059, 4095
+};
+
+/**
+ * The Lab f() function at every 32 steps of its 12 bits input, in 12 bits
+ * fixed point. The first step is within the linear part of f().
+ */
+static const unsigned int cubeRootTable[129] PROGMEM = {
+    565, 814, 1024, 1172, 1290, 1390, 1477, 1555, 1625, 1691, 1751, 1808,
+    1861, 1911, 1959, 2004, 2048, 2090, 2130, 2169, 2206, 2242, 2277, 2311,
+    2344, 2376, 2408, 2438, 2468, 2497, 2525, 2553, 2580, 2607, 2633, 2659,
+    2684, 2708, 2732, 2756, 2780, 2803, 2825, 2847, 2869, 2891, 2912, 2933,
+    2954, 2974, 2994, 3014, 3034, 3053, 3072, 3091, 3109, 3128, 3146, 3164,
+    3182, 3199, 3217, 3234, 3251, 3268, 3285, 3301, 3317, 3334, 3350, 3365,
+    3381, 3397, 3412, 3427, 3443, 3458, 3473, 3487, 3502, 3517, 3531, 3545,
+    3559, 3574, 3587, 3601, 3615, 3629, 3642, 3656, 3669, 3682, 3695, 3708,
+    3721, 3734, 3747, 3760, 3772, 3785, 3797, 3810, 3822, 3834, 3846, 3858,
+    3870, 3882, 3894, 3906, 3918, 3929, 3941, 3952, 3964, 3975, 3986, 3998,
+    4009, 4020, 4031, 4042, 4053, 4064, 4075, 4085, 4096
+};
+
+/**
+ * The rows of the linear sRGB to XYZ matrix, divided by the D65 white, in 12
+ * bits fixed point. Each row adds up to 4096, so white is 4095 on all three.
+ */
+static const unsigned int xyzMatrix[3][3] = {
+    { 1777, 1541, 778 },
+    { 871, 2929, 296 },
+    { 73, 448, 3575 }
+};
+
+/**
+ * Returns (a - b) * 256 / delta, rounded toward 0. The difference is scaled 
+ * as unsigned, so it does not overflow a 16 bits int.
+ */
+static int hueOffset(unsigned char a, unsigned char b, unsigned char delta) {
+    if (a >= b) {
+        return (int) (((unsigned int) (a - b) << 8) / delta);
+    }
+    return -(int) (((unsigned int) (b - a) << 8) / delta);
+}
+
+void ColorRecognitionColorSpace::toHsv(const unsigned char rgb[3], ColorRecognitionHsv* hsv) {
+    unsigned char max = rgb[0], min = rgb[0];
+    unsigned char delta;
+    int hue;
+    if (rgb[1] > max) {
+        max = rgb[1];
+    } else if (rgb[1] < min) {
+        min = rgb[1];
+    }
+    if (rgb[2] > max) {
+        max = rgb[2];
+    } else if (rgb[2] < min) {
+        min = rgb[2];
+    }
+    delta = max - min;
+    hsv->value = max;
+    if (delta == 0) {
+        hsv->hue = 0;
+        hsv->saturation = 0;
+        return;
+    }
+    hsv->saturation = (unsigned char) (((unsigned int) delta * 255 + (max >> 1)) / max);
+    if (max == rgb[0]) {
+        hue = hueOffset(rgb[1], rgb[2], delta);
+        if (hue < 0) {
+            hue += COLOR_SPACE_HUE_STEPS;
+        }
+    } else if (max == rgb[1]) {
+        hue = 512 + hueOffset(rgb[2], rgb[0], delta);
+    } else {
+        hue = 1024 + hueOffset(rgb[0], rgb[1], delta);
+    }
+    hsv->hue = (unsigned int) hue;
+}
+
+void ColorRecognitionColorSpace::toHsv(const unsigned char rgb[][3], ColorRecognitionHsv hsv[], unsigned char n) {
+    for (unsigned char i = 0; i < n; i++) {
+        toHsv(rgb[i], &hsv[i]);
+    }
+}
+
+void ColorRecognitionColorSpace::toLab(const unsigned char rgb[3], ColorRecognitionLab* lab, bool gammaEncoded) {
+    unsigned int linear[3], f[3];
+    unsigned long t;
+    long a, b;
+    linear[0] = toLinear(rgb[0], gammaEncoded);
+    linear[1] = toLinear(rgb[1], gammaEncoded);
+    linear[2] = toLinear(rgb[2], gammaEncoded);
+    for (unsigned char i = 0; i < 3; i++) {
+        t = (unsigned long) xyzMatrix[i][0] * linear[0] + (unsigned long) xyzMatrix[i][1] * linear[1]
+                + (unsigned long) xyzMatrix[i][2] * linear[2];
+        f[i] = cubeRoot((unsigned int) (t >> COLOR_SPACE_FRACTION_BITS));
+    }
+    // f(0) is 16/116, so the lightness is never negative.
+    lab->lightness = (unsigned char) (((116UL * f[1] + 2048) >> COLOR_SPACE_FRACTION_BITS) - 16);
+    a = (500L * ((long) f[0] - (long) f[1]) + 2048) >> COLOR_SPACE_FRACTION_BITS;
+    b = (200L * ((long) f[1] - (long) f[2]) + 2048) >> COLOR_SPACE_FRACTION_BITS;
+    lab->a = (signed char) (a < -128 ? -128 : (a > 127 ? 127 : a));
+    lab->b = (signed char) (b < -128 ? -128 : (b > 127 ? 127 : b));
+}
+
+void ColorRecognitionColorSpace::toLab(const unsigned char rgb[][3], ColorRecognitionLab lab[], unsigned char n,
+        bool gammaEncoded) {
+    for (unsigned char i = 0; i < n; i++) {
+        toLab(rgb[i], &lab[i], gammaEncoded);
+    }
+}
+
+unsigned int ColorRecognitionColorSpace::getHueDistance(unsigned int hue1, unsigned int hue2) {
+    unsigned int distance = (hue1 > hue2) ? hue1 - hue2 : hue2 - hue1;
+    if (distance > COLOR_SPACE_HUE_STEPS / 2) {
+        distance = COLOR_SPACE_HUE_STEPS - distance;
+    }
+    return distance;
+}
+
+unsigned long ColorRecognitionColorSpace::getDistance(const ColorRecognitionLab* lab1,
+        const ColorRecognitionLab* lab2) {
+    int dl = (int) lab1->lightness - lab2->lightness;
+    int da = (int) lab1->a - lab2->a;
+    int db = (int) lab1->b - lab2->b;
+    return (unsigned long) ((long) dl * dl) + (unsigned long) ((long) da * da) + (unsigned long) ((long) db * db);
+}
+
+unsigned int ColorRecognitionColorSpace::toLinear(unsigned char intensity, bool gammaEncoded) {
+    if (gammaEncoded) {
+        return pgm_read_word(&gammaTable[intensity]);
+    }
+    // Stretches 0 to 255 over 0 to 4095.
+    return ((unsigned int) intensity << 4) | (intensity >> 4);
+}
+
+unsigned int ColorRecognitionColorSpace::cubeRoot(unsigned int t) {
+    unsigned char i = t >> 5;
+    unsigned int low = pgm_read_word(&cubeRootTable[i]);
+    unsigned int high = pgm_read_word(&cubeRootTable[i + 1]);
+    return low + (((high - low) * (t & 31)) >> 5);
+}
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_COLOR_SPACE_CPP__ */
@@ -0,0 +1,161 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionColorSpace.h
+ * 
+ * Converts color intensities to HSV and CIE Lab with integer kernels and 
+ * small lookup tables in the flash.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_COLOR_SPACE_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_COLOR_SPACE_H__ 1
+
+/**
+ * How the kernels work:
+ * 
+ * HSV takes the usual hexcone formula with the hue in 1/256 of a sextant, 
+ * so the hue is two 16 bits divisions and no float.
+ * 
+ * Lab expands the intensities to 12 bits linear light, multiplies them by 
+ * the sRGB to XYZ matrix (D65), already divided by the white point, in 12 
+ * bits fixed point, and takes the cube root of the Lab f() function from a 
+ * 129 entries table, linearly interpolated. The result is within 1.2 delta
+ * E of the float conversion (see make bench).
+ * 
+ * The TCS230 intensities are linear in the light, so they are converted as
+ * they are. Colors given in sRGB, like the ones of a screen palette, are
+ * decoded first with the 256 entries gamma table.
+ */
+
+/**
+ * The number of hue steps. The hue is 0 for red, 512 for green and 1024 
+ * for blue.
+ */
+#define COLOR_SPACE_HUE_STEPS 1536
+
+/**
+ * The fraction bits of the fixed point linear light and XYZ values.
+ */
+#define COLOR_SPACE_FRACTION_BITS 12
+
+/**
+ * A color in the HSV color space.
+ */
+struct ColorRecognitionHsv {
+
+    /**
+     * The hue, from 0 to COLOR_SPACE_HUE_STEPS - 1.
+     */
+    unsigned int hue;
+
+    /**
+     * The saturation, from 0 to 255.
+     */
+    unsigned char saturation;
+
+    /**
+     * The value, from 0 to 255.
+     */
+    unsigned char value;
+};
+
+/**
+ * A color in the CIE Lab color space, D65 white point.
+ */
+struct ColorRecognitionLab {
+
+    /**
+     * The lightness L*, from 0 to 100.
+     */
+    unsigned char lightness;
+
+    /**
+     * The a* and b* components, clamped to -128 and 127.
+     */
+    signed char a;
+    signed char b;
+};
+
+class ColorRecognitionColorSpace {
+public:
+
+    /**
+     * Converts a color to HSV.
+     * 
+     * @param rgb           The red, green and blue intensities.
+     * @param hsv           The color to fill.
+     */
+    static void toHsv(const unsigned char rgb[3], ColorRecognitionHsv* hsv);
+
+    /**
+     * Converts a batch of colors to HSV.
+     * 
+     * @param rgb           The red, green and blue intensities of each color.
+     * @param hsv           The colors to fill.
+     * @param n             The number of colors.
+     */
+    static void toHsv(const unsigned char rgb[][3], ColorRecognitionHsv hsv[], unsigned char n);
+
+    /**
+     * Converts a color to Lab.
+     * 
+     * @param rgb           The red, green and blue intensities.
+     * @param lab           The color to fill.
+     * @param gammaEncoded  If the intensities are sRGB encoded instead of 
+     *                      linear, as the sensors give them.
+     */
+    static void toLab(const unsigned char rgb[3], ColorRecognitionLab* lab, bool gammaEncoded = false);
+
+    /**
+     * Converts a batch of colors to Lab.
+     * 
+     * @param rgb           The red, green and blue intensities of each color.
+     * @param lab           The colors to fill.
+     * @param n             The number of colors.
+     * @param gammaEncoded  If the intensities are sRGB encoded.
+     */
+    static void toLab(const unsigned char rgb[][3], ColorRecognitionLab lab[], unsigned char n,
+            bool gammaEncoded = false);
+
+    /**
+     * Returns the distance between two hues, going the short way around.
+     * 
+     * @param hue1          The first hue.
+     * @param hue2          The second hue.
+     * @return              The distance, from 0 to COLOR_SPACE_HUE_STEPS / 2.
+     */
+    static unsigned int getHueDistance(unsigned int hue1, unsigned int hue2);
+
+    /**
+     * Returns the squared CIE76 color difference (delta E) between two 
+     * colors. A delta E of about 2.3 is the smallest difference the eye sees.
+     * 
+     * @param lab1          The first color.
+     * @param lab2          The second color.
+     * @return              The squared delta E.
+     */
+    static unsigned long getDistance(const ColorRecognitionLab* lab1, const ColorRecognitionLab* lab2);
+
+private:
+
+    /**
+     * Returns the linear light of an intensity.
+     * 
+     * @param intensity     The intensity.
+     * @param gammaEncoded  If the intensity is sRGB encoded.
+     * @return              The linear light, from 0 to 4095.
+     */
+    static unsigned int toLinear(unsigned char intensity, bool gammaEncoded);
+
+    /**
+     * Returns the Lab f() function of a XYZ component divided by its white.
+     * 
+     * @param t             The component, from 0 to 4095.
+     * @return              f(t), in 12 bits fixed point.
+     */
+    static unsigned int cubeRoot(unsigned int t);
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_COLOR_SPACE_H__ */
@@ -0,0 +1,46 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionCrc.h
+ * 
+ * The CRC-16/CCITT that protects the records and the packets written by the
+ * library.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_CRC_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_CRC_H__ 1
+
+/**
+ * The initial value of the CRC.
+ * 
+ * The CRC is appended most significant byte first, so the CRC of the data 
+ * followed by its own CRC is 0.
+ */
+#define CRC_INITIAL_VALUE 0xffff
+
+class ColorRecognitionCrc {
+public:
+
+    /**
+     * Updates a CRC-16/CCITT (polynomial 0x1021) with one byte.
+     * 
+     * @param crc           The CRC.
+     * @param data          The byte.
+     * @return              The updated CRC.
+     */
+    static unsigned int update(unsigned int crc, unsigned char data) {
+        crc ^= (unsigned int) data << 8;
+        for (unsigned char i = 0; i < 8; i++) {
+            if (crc & 0x8000) {
+                crc = (crc << 1) ^ 0x1021;
+            } else {
+                crc <<= 1;
+            }
+        }
+        return crc & 0xffff;
+    }
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_CRC_H__ */
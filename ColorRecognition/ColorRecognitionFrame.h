@@ -0,0 +1,36 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionFrame.h
+ * 
+ * A coherent set of channel measures, taken by one acquisition cycle.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_FRAME_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_FRAME_H__ 1
+
+struct ColorRecognitionFrame {
+
+    /**
+     * The frame number. It starts at 1 and increments by one for each frame, 
+     * so a gap means dropped frames and a repeated number means the same 
+     * frame was read twice. 0 means no frame was acquired yet.
+     */
+    unsigned long sequence;
+
+    /**
+     * When the frame was completed, in microseconds (micros()).
+     */
+    unsigned long timestamp;
+
+    /**
+     * The red, green, blue and clear frequencies, in Hz, normalized to the 
+     * 100% output frequency scaling. The clear frequency is 0 when it is not
+     * acquired.
+     */
+    long frequencies[4];
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_FRAME_H__ */
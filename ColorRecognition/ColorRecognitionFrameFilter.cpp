@@ -0,0 +1,143 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionFrameFilter.h
+ * 
+ * Fixed-point filters applied to the frequencies of each frame, between the
+ * acquisition and the conversion to intensities.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_FRAME_FILTER_CPP__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_FRAME_FILTER_CPP__ 1
+
+#include "ColorRecognitionFrameFilter.h"
+
+ColorRecognitionFrameFilter* ColorRecognitionFrameFilter::setNext(ColorRecognitionFrameFilter* next) {
+    this->next = next;
+    return next;
+}
+
+void ColorRecognitionFrameFilter::apply(long* frequencies, unsigned char channels) {
+    ColorRecognitionFrameFilter* filter = this;
+    if (channels > FILTER_CHANNELS) {
+        channels = FILTER_CHANNELS;
+    }
+    while (filter != 0) {
+        filter->process(frequencies, channels);
+        filter = filter->next;
+    }
+}
+
+void ColorRecognitionFrameFilter::resetChain() {
+    for (ColorRecognitionFrameFilter* filter = this; filter != 0; filter = filter->next) {
+        filter->reset();
+    }
+}
+
+ColorRecognitionIIRFilter::ColorRecognitionIIRFilter(unsigned char shift)
+        : primed(false) {
+    if (shift < 1) {
+        shift = 1;
+    } else if (shift > 8) {
+        shift = 8;
+    }
+    this->shift = shift;
+    reset();
+}
+
+void ColorRecognitionIIRFilter::process(long* frequencies, unsigned char channels) {
+    for (unsigned char i = 0; i < channels; i++) {
+        long input = frequencies[i] << IIR_FRACTION_BITS;
+        if (primed) {
+            states[i] += (input - states[i]) >> shift;
+        } else {
+            states[i] = input;
+        }
+        frequencies[i] = (states[i] + (1L << (IIR_FRACTION_BITS - 1))) >> IIR_FRACTION_BITS;
+    }
+    primed = true;
+}
+
+void ColorRecognitionIIRFilter::reset() {
+    primed = false;
+    for (unsigned char i = 0; i < FILTER_CHANNELS; i++) {
+        states[i] = 0;
+    }
+}
+
+ColorRecognitionMedianFilter::ColorRecognitionMedianFilter(unsigned char window) {
+    if (window < 3) {
+        window = 3;
+    } else if (window > MEDIAN_MAX_WINDOW) {
+        window = MEDIAN_MAX_WINDOW;
+    }
+    this->window = window | 1;
+    reset();
+}
+
+void ColorRecognitionMedianFilter::process(long* frequencies, unsigned char channels) {
+    long sorted[MEDIAN_MAX_WINDOW];
+    long value;
+    unsigned char i, j, k;
+    if (filled < window) {
+        filled++;
+    }
+    for (i = 0; i < channels; i++) {
+        history[i][position] = frequencies[i];
+        // Insertion sort of the history, at most 5 values.
+        for (j = 0; j < filled; j++) {
+            value = history[i][j];
+            for (k = j; k > 0 && sorted[k - 1] > value; k--) {
+                sorted[k] = sorted[k - 1];
+            }
+            sorted[k] = value;
+        }
+        frequencies[i] = sorted[filled >> 1];
+    }
+    if (++position >= window) {
+        position = 0;
+    }
+}
+
+void ColorRecognitionMedianFilter::reset() {
+    filled = 0;
+    position = 0;
+}
+
+ColorRecognitionSpikeFilter::ColorRecognitionSpikeFilter(unsigned int threshold, unsigned char maxRejections)
+        : threshold(threshold), maxRejections(maxRejections) {
+    reset();
+}
+
+void ColorRecognitionSpikeFilter::process(long* frequencies, unsigned char channels) {
+    long jump, limit;
+    for (unsigned char i = 0; i < channels; i++) {
+        if (primed) {
+            jump = frequencies[i] - lastValues[i];
+            if (jump < 0) {
+                jump = -jump;
+            }
+            limit = (lastValues[i] >> 8) * threshold + (((lastValues[i] & 0xff) * threshold) >> 8);
+            if (jump > limit && rejections[i] < maxRejections) {
+                rejections[i]++;
+                frequencies[i] = lastValues[i];
+                continue;
+            }
+        }
+        rejections[i] = 0;
+        lastValues[i] = frequencies[i];
+    }
+    primed = true;
+}
+
+void ColorRecognitionSpikeFilter::reset() {
+    primed = false;
+    for (unsigned char i = 0; i < FILTER_CHANNELS; i++) {
+        rejections[i] = 0;
+        lastValues[i] = 0;
+    }
+}
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_FRAME_FILTER_CPP__ */
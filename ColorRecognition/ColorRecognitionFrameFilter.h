@@ -0,0 +1,218 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionFrameFilter.h
+ * 
+ * Fixed-point filters applied to the frequencies of each frame, between the
+ * acquisition and the conversion to intensities.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_FRAME_FILTER_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_FRAME_FILTER_H__ 1
+
+/**
+ * The maximum number of channels of a frame: red, green, blue and clear.
+ */
+#define FILTER_CHANNELS 4
+
+/**
+ * The fraction bits kept by the IIR filter state.
+ */
+#define IIR_FRACTION_BITS 4
+
+/**
+ * The longest window of the median filter.
+ */
+#define MEDIAN_MAX_WINDOW 5
+
+/**
+ * The abstract class for the frame filters.
+ * 
+ * The filters are chained with setNext(), and a driver runs the whole chain
+ * on each frame it completes. The counting driver runs it inside the
+ * scheduler interrupt, so the filters only use integer adds, compares and
+ * shifts.
+ */
+class ColorRecognitionFrameFilter {
+private:
+
+    /**
+     * The next filter of the chain.
+     */
+    ColorRecognitionFrameFilter* next;
+
+public:
+
+    ColorRecognitionFrameFilter()
+            : next(0) {
+    }
+
+    virtual ~ColorRecognitionFrameFilter() {
+    }
+
+    /**
+     * Sets the filter that runs after this one.
+     * 
+     * @param next          The next filter, NULL to end the chain.
+     * @return              The next filter, to chain further.
+     */
+    ColorRecognitionFrameFilter* setNext(ColorRecognitionFrameFilter* next);
+
+    /**
+     * Runs this filter and the rest of the chain on a frame.
+     * 
+     * @param frequencies   The frequencies, in Hz, filtered in place.
+     * @param channels      The number of channels (up to FILTER_CHANNELS).
+     */
+    void apply(long* frequencies, unsigned char channels);
+
+    /**
+     * Forgets the history of this filter and the rest of the chain.
+     */
+    void resetChain();
+
+    /**
+     * Filters a frame in place.
+     * 
+     * @param frequencies   The frequencies, in Hz.
+     * @param channels      The number of channels.
+     */
+    virtual void process(long* frequencies, unsigned char channels) = 0;
+
+    /**
+     * Forgets the history, so the next frame passes through unchanged.
+     */
+    virtual void reset() = 0;
+};
+
+/**
+ * Exponential (first order IIR) smoothing: y += (x - y) / 2^shift.
+ * 
+ * A shift of 1 averages about the last 2 frames, 2 the last 4, 3 the last 8.
+ * It removes the flicker at the cost of lag.
+ */
+class ColorRecognitionIIRFilter: public ColorRecognitionFrameFilter {
+private:
+
+    /**
+     * The smoothing shift.
+     */
+    unsigned char shift;
+
+    /**
+     * Whether the state holds a frame.
+     */
+    bool primed;
+
+    /**
+     * The filtered frequencies, with IIR_FRACTION_BITS fraction bits.
+     */
+    long states[FILTER_CHANNELS];
+
+public:
+
+    /**
+     * Public constructor.
+     * 
+     * @param shift         The smoothing shift (1 to 8).
+     */
+    ColorRecognitionIIRFilter(unsigned char shift = 2);
+
+    void process(long* frequencies, unsigned char channels);
+
+    void reset();
+};
+
+/**
+ * Running median of the last frames. It removes single frame outliers
+ * without smearing steps, with a delay of half the window.
+ */
+class ColorRecognitionMedianFilter: public ColorRecognitionFrameFilter {
+private:
+
+    /**
+     * The window length.
+     */
+    unsigned char window;
+
+    /**
+     * How many frames the history holds.
+     */
+    unsigned char filled;
+
+    /**
+     * Where the next frame is stored in the history.
+     */
+    unsigned char position;
+
+    /**
+     * The last frames of each channel.
+     */
+    long history[FILTER_CHANNELS][MEDIAN_MAX_WINDOW];
+
+public:
+
+    /**
+     * Public constructor.
+     * 
+     * @param window        The window length (3 or 5).
+     */
+    ColorRecognitionMedianFilter(unsigned char window = 3);
+
+    void process(long* frequencies, unsigned char channels);
+
+    void reset();
+};
+
+/**
+ * Spike rejection: a channel that jumps from its last accepted value by
+ * more than the threshold is held at the last value, unless the jump lasts,
+ * in which case it is a real change and is accepted.
+ */
+class ColorRecognitionSpikeFilter: public ColorRecognitionFrameFilter {
+private:
+
+    /**
+     * The threshold, in 1/256 of the last accepted value.
+     */
+    unsigned int threshold;
+
+    /**
+     * How many consecutive frames are rejected before a jump is accepted.
+     */
+    unsigned char maxRejections;
+
+    /**
+     * Whether the last values hold a frame.
+     */
+    bool primed;
+
+    /**
+     * The consecutive rejections of each channel.
+     */
+    unsigned char rejections[FILTER_CHANNELS];
+
+    /**
+     * The last accepted frequencies.
+     */
+    long lastValues[FILTER_CHANNELS];
+
+public:
+
+    /**
+     * Public constructor.
+     * 
+     * @param threshold     The largest accepted jump, in 1/256 of the last
+     *                      value (64 is 25%).
+     * @param maxRejections How many consecutive frames a jump is rejected.
+     */
+    ColorRecognitionSpikeFilter(unsigned int threshold = 64, unsigned char maxRejections = 1);
+
+    void process(long* frequencies, unsigned char channels);
+
+    void reset();
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_FRAME_FILTER_H__ */
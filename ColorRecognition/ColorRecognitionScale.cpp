@@ -0,0 +1,36 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionScale.h
+ * 
+ * Converts frequencies to color intensities with integer reciprocals.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_SCALE_CPP__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_SCALE_CPP__ 1
+
+#include "ColorRecognitionScale.h"
+
+ColorRecognitionScale::ColorRecognitionScale(long whiteFrequency) {
+    for (unsigned char i = 0; i < SCALE_CHANNELS; i++) {
+        calibrate(i, 0, whiteFrequency);
+    }
+}
+
+void ColorRecognitionScale::calibrate(unsigned char channel, long blackFrequency, long whiteFrequency) {
+    unsigned long range;
+    if (whiteFrequency <= blackFrequency) {
+        whiteFrequency = blackFrequency + 1;
+    }
+    range = whiteFrequency - blackFrequency;
+    blackFrequencies[channel] = blackFrequency;
+    whiteFrequencies[channel] = whiteFrequency;
+    factors[channel] = (255UL << SCALE_FRACTION_BITS) / range;
+    if ((255UL << SCALE_FRACTION_BITS) % range != 0) {
+        factors[channel]++;
+    }
+}
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_SCALE_CPP__ */
@@ -0,0 +1,175 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionScale.h
+ * 
+ * Converts frequencies to color intensities with integer reciprocals.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_SCALE_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_SCALE_H__ 1
+
+/**
+ * The fraction bits of the scale factors.
+ * 
+ * The intensity is ((frequency - black) * factor) >> 24, where factor is
+ * 255 * 2^24 / (white - black) rounded up. The frequency is clamped to the
+ * black and white range first, so the product is under 255 * 2^24 and fits 32
+ * bits, and the result is within one step of map().
+ * 
+ * The 16 bits intensity takes the same product shifted by 8 bits less, 
+ * from 0 to 65280, stretched to 65535. The rounding of the factor makes it
+ * off by up to (white - black) / 2^16 steps, under 0.02% of the range for
+ * any frequency of the sensor (600 kHz at most).
+ */
+#define SCALE_FRACTION_BITS 24
+
+/**
+ * The number of channels: red, green, blue and clear.
+ */
+#define SCALE_CHANNELS 4
+
+class ColorRecognitionScale {
+private:
+
+    /**
+     * The black frequency of each channel, in Hz.
+     */
+    long blackFrequencies[SCALE_CHANNELS];
+
+    /**
+     * The white frequency of each channel, in Hz.
+     */
+    long whiteFrequencies[SCALE_CHANNELS];
+
+    /**
+     * The reciprocal scale factor of each channel.
+     */
+    unsigned long factors[SCALE_CHANNELS];
+
+public:
+
+    /**
+     * Public constructor. All channels are calibrated from 0 to the given 
+     * white frequency.
+     * 
+     * @param whiteFrequency    The white frequency, in Hz.
+     */
+    ColorRecognitionScale(long whiteFrequency);
+
+    /**
+     * Calibrates one channel. It is the only place where a division is done.
+     * 
+     * @param channel           The channel (0 red, 1 green, 2 blue, 3 
+     *                          clear).
+     * @param blackFrequency    The frequency read as intensity 0, in Hz.
+     * @param whiteFrequency    The frequency read as intensity 255, in Hz.
+     */
+    void calibrate(unsigned char channel, long blackFrequency, long whiteFrequency);
+
+    /**
+     * Sets the white frequency of one channel, keeping its black frequency.
+     * 
+     * @param channel           The channel.
+     * @param whiteFrequency    The frequency read as intensity 255, in Hz.
+     */
+    void setWhite(unsigned char channel, long whiteFrequency) {
+        calibrate(channel, blackFrequencies[channel], whiteFrequency);
+    }
+
+    /**
+     * Sets the black frequency of one channel, keeping its white frequency.
+     * 
+     * @param channel           The channel.
+     * @param blackFrequency    The frequency read as intensity 0, in Hz.
+     */
+    void setBlack(unsigned char channel, long blackFrequency) {
+        calibrate(channel, blackFrequency, whiteFrequencies[channel]);
+    }
+
+    /**
+     * Returns the white frequency of one channel.
+     * 
+     * @param channel           The channel.
+     * @return                  The white frequency, in Hz.
+     */
+    long getWhite(unsigned char channel) {
+        return whiteFrequencies[channel];
+    }
+
+    /**
+     * Returns the black frequency of one channel.
+     * 
+     * @param channel           The channel.
+     * @return                  The black frequency, in Hz.
+     */
+    long getBlack(unsigned char channel) {
+        return blackFrequencies[channel];
+    }
+
+    /**
+     * Converts the frequency of one channel to color intensity.
+     * 
+     * @param channel           The channel.
+     * @param frequency         The frequency, in Hz.
+     * @return                  The color intensity.
+     */
+    unsigned char toIntensity(unsigned char channel, long frequency) {
+        if (frequency <= blackFrequencies[channel]) {
+            return 0;
+        }
+        if (frequency >= whiteFrequencies[channel]) {
+            return 255;
+        }
+        return (unsigned char) (((unsigned long) (frequency - blackFrequencies[channel]) * factors[channel])
+                >> SCALE_FRACTION_BITS);
+    }
+
+    /**
+     * Converts the frequencies of all channels to color intensities.
+     * 
+     * @param frequencies       The red, green and blue frequencies, in Hz.
+     * @param buf               The buffer to fill.
+     */
+    void toIntensities(const long frequencies[3], unsigned char buf[3]) {
+        buf[0] = toIntensity(0, frequencies[0]);
+        buf[1] = toIntensity(1, frequencies[1]);
+        buf[2] = toIntensity(2, frequencies[2]);
+    }
+
+    /**
+     * Converts the frequency of one channel to a 16 bits color intensity.
+     * 
+     * @param channel           The channel.
+     * @param frequency         The frequency, in Hz.
+     * @return                  The color intensity, from 0 to 65535.
+     */
+    unsigned int toIntensity16(unsigned char channel, long frequency) {
+        unsigned long intensity;
+        if (frequency <= blackFrequencies[channel]) {
+            return 0;
+        }
+        if (frequency >= whiteFrequencies[channel]) {
+            return 65535U;
+        }
+        intensity = ((unsigned long) (frequency - blackFrequencies[channel]) * factors[channel])
+                >> (SCALE_FRACTION_BITS - 8);
+        return (unsigned int) (intensity + (intensity >> 8));
+    }
+
+    /**
+     * Converts the frequencies of all channels to 16 bits color intensities.
+     * 
+     * @param frequencies       The red, green and blue frequencies, in Hz.
+     * @param buf               The buffer to fill.
+     */
+    void toIntensities16(const long frequencies[3], unsigned int buf[3]) {
+        buf[0] = toIntensity16(0, frequencies[0]);
+        buf[1] = toIntensity16(1, frequencies[1]);
+        buf[2] = toIntensity16(2, frequencies[2]);
+    }
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_SCALE_H__ */
@@ -0,0 +1,84 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionStatistics.h
+ * 
+ * The counters a driver keeps about its own acquisition, to tell why the
+ * readings degrade.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_STATISTICS_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_STATISTICS_H__ 1
+
+/**
+ * Set to 1 to keep the statistics. When 0 (the default) the counters, the
+ * code that updates them and getStatistics()/resetStatistics() are not
+ * compiled at all.
+ * 
+ * NOTE: The Arduino IDE compiles the libraries without the defines of the
+ * sketch, so it must be changed here, or given to the compiler (for example
+ * -DCOLOR_RECOGNITION_STATISTICS=1 in the build flags).
+ */
+#ifndef COLOR_RECOGNITION_STATISTICS
+#define COLOR_RECOGNITION_STATISTICS 0
+#endif
+
+struct ColorRecognitionStatistics {
+
+    /**
+     * When the statistics were reset, in microseconds (micros()). The rates
+     * are the counters divided by the time since then.
+     */
+    unsigned long since;
+
+    /**
+     * The out pin pulses: counted by the interrupt or by Timer5, or the
+     * periods timed by polling the pin.
+     */
+    unsigned long edges;
+
+    /**
+     * The measures: gates ended, or channels measured by polling the pin.
+     */
+    unsigned long measures;
+
+    /**
+     * The measures without pulses: gates where no edge was counted, or
+     * waits for an edge of the polled pin that timed out.
+     */
+    unsigned long timeouts;
+
+    /**
+     * The channels measured at or above the white balance, which read as
+     * intensity 255 whatever their real brightness.
+     */
+    unsigned long saturations;
+
+    /**
+     * The frames dropped because the ring buffer was full.
+     */
+    unsigned int overruns;
+
+    /**
+     * The wraps of the 16 bits Timer5 counter, each adding 65536 pulses to
+     * the count by the overflow interrupt.
+     */
+    unsigned int counterOverflows;
+
+    /**
+     * The largest difference between the programmed and the real length of
+     * a gate, in microseconds.
+     */
+    unsigned int maxJitter;
+
+    /**
+     * The shortest and the longest timer interrupt, in microseconds. The
+     * minimum is 0xffff until an interrupt runs.
+     */
+    unsigned int minInterruptTime;
+    unsigned int maxInterruptTime;
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_STATISTICS_H__ */
@@ -0,0 +1,89 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionStream.h
+ * 
+ * Streams frames as compact binary packets, for logging at high baud rates.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_STREAM_CPP__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_STREAM_CPP__ 1
+
+#include "ColorRecognitionStream.h"
+#include "ColorRecognitionCrc.h"
+
+ColorRecognitionStream::ColorRecognitionStream(Print* output)
+        : output(output), packets(0) {
+}
+
+bool ColorRecognitionStream::write(const ColorRecognitionFrame* frame, unsigned char flags) {
+    unsigned char buffer[STREAM_ENCODED_SIZE];
+    unsigned char size = encode(frame, flags, buffer);
+    if (output->write(buffer, size) != size) {
+        return false;
+    }
+    packets++;
+    return true;
+}
+
+unsigned char ColorRecognitionStream::writeFrames(const ColorRecognitionFrame* frames, unsigned char n,
+        unsigned char flags) {
+    unsigned char written = 0;
+    while (written < n && write(&frames[written], flags)) {
+        written++;
+    }
+    return written;
+}
+
+unsigned long ColorRecognitionStream::getPacketCount() {
+    return packets;
+}
+
+unsigned char ColorRecognitionStream::encode(const ColorRecognitionFrame* frame, unsigned char flags,
+        unsigned char* buffer) {
+    unsigned char* packet = buffer + 1;
+    unsigned char i, j, code, codeIndex;
+    unsigned long value;
+    unsigned int crc = CRC_INITIAL_VALUE;
+    packet[0] = STREAM_VERSION;
+    packet[1] = flags;
+    for (i = 0; i < 6; i++) {
+        // The sequence, the timestamp and the 4 frequencies.
+        if (i == 0) {
+            value = frame->sequence;
+        } else if (i == 1) {
+            value = frame->timestamp;
+        } else {
+            value = (unsigned long) frame->frequencies[i - 2];
+        }
+        for (j = 0; j < 4; j++) {
+            packet[2 + i * 4 + j] = (unsigned char) (value >> (j * 8));
+        }
+    }
+    for (i = 0; i < STREAM_PAYLOAD_SIZE; i++) {
+        crc = ColorRecognitionCrc::update(crc, packet[i]);
+    }
+    packet[STREAM_PAYLOAD_SIZE] = crc >> 8;
+    packet[STREAM_PAYLOAD_SIZE + 1] = crc & 0xff;
+
+    // COBS in place: each zero byte becomes the distance to the next one,
+    // and the first distance goes in front of the packet.
+    codeIndex = 0;
+    code = 1;
+    for (i = 1; i <= STREAM_PACKET_SIZE; i++) {
+        if (buffer[i] == 0) {
+            buffer[codeIndex] = code;
+            codeIndex = i;
+            code = 1;
+        } else {
+            code++;
+        }
+    }
+    buffer[codeIndex] = code;
+    buffer[STREAM_ENCODED_SIZE - 1] = 0;
+    return STREAM_ENCODED_SIZE;
+}
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_STREAM_CPP__ */
@@ -0,0 +1,123 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionStream.h
+ * 
+ * Streams frames as compact binary packets, for logging at high baud rates.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_STREAM_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_STREAM_H__ 1
+
+#include <Print.h>
+#include <ColorRecognitionFrame.h>
+
+/**
+ * The packet layout, all fields little endian:
+ * 
+ * <pre>
+ * OFFSET   BYTES   FIELD
+ * 0        1       Version (STREAM_VERSION)
+ * 1        1       Flags (STREAM_FLAG_*)
+ * 2        4       Sequence
+ * 6        4       Timestamp, in microseconds
+ * 10       16      Red, green, blue and clear frequencies, in Hz
+ * 26       2       CRC-16/CCITT of the previous bytes, most significant first
+ * </pre>
+ * 
+ * The packet is COBS (Consistent Overhead Byte Stuffing) encoded, which
+ * removes the zero bytes at the cost of one byte, and followed by a zero
+ * byte, so each packet takes STREAM_ENCODED_SIZE bytes and a receiver
+ * resynchronizes at the next zero after any lost or corrupted byte.
+ * 
+ * At 115200 baud it carries 384 frames per second, where printing the
+ * intensities as text at 9600 baud carries about 30.
+ */
+
+/**
+ * The version of the packet layout.
+ */
+#define STREAM_VERSION 1
+
+/**
+ * The packet sizes: the fields, the fields with the CRC, and the encoded
+ * packet with its delimiter.
+ */
+#define STREAM_PAYLOAD_SIZE 26
+#define STREAM_PACKET_SIZE (STREAM_PAYLOAD_SIZE + 2)
+#define STREAM_ENCODED_SIZE (STREAM_PACKET_SIZE + 2)
+
+/**
+ * The packet flags.
+ * 
+ * STREAM_FLAG_OVERRUN: the driver dropped frames before this one.
+ * STREAM_FLAG_NO_CLEAR: the clear frequency was not acquired.
+ * STREAM_FLAG_USER: the first flag free for the sketch.
+ */
+#define STREAM_FLAG_OVERRUN 0x01
+#define STREAM_FLAG_NO_CLEAR 0x02
+#define STREAM_FLAG_USER 0x10
+
+class ColorRecognitionStream {
+private:
+
+    /**
+     * Where the packets are written.
+     */
+    Print* output;
+
+    /**
+     * How many packets were written.
+     */
+    unsigned long packets;
+
+public:
+
+    /**
+     * Public constructor.
+     * 
+     * @param output        Where the packets are written, usually &Serial.
+     */
+    ColorRecognitionStream(Print* output);
+
+    /**
+     * Writes a frame as a packet.
+     * 
+     * @param frame         The frame.
+     * @param flags         The packet flags.
+     * @return              If the whole packet was written.
+     */
+    bool write(const ColorRecognitionFrame* frame, unsigned char flags = 0);
+
+    /**
+     * Writes frames as packets, for example the ones drained from the ring
+     * buffer of a driver.
+     * 
+     * @param frames        The frames.
+     * @param n             How many frames.
+     * @param flags         The flags of all the packets.
+     * @return              How many packets were written.
+     */
+    unsigned char writeFrames(const ColorRecognitionFrame* frames, unsigned char n, unsigned char flags = 0);
+
+    /**
+     * Returns how many packets were written.
+     * 
+     * @return              The number of packets.
+     */
+    unsigned long getPacketCount();
+
+    /**
+     * Encodes a frame as a packet, ready to be sent.
+     * 
+     * @param frame         The frame.
+     * @param flags         The packet flags.
+     * @param buffer        The buffer to fill, of STREAM_ENCODED_SIZE bytes.
+     * @return              The packet size, STREAM_ENCODED_SIZE.
+     */
+    static unsigned char encode(const ColorRecognitionFrame* frame, unsigned char flags, unsigned char* buffer);
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_STREAM_H__ */
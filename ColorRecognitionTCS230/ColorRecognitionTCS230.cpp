@@ -17,94 +17,1010 @@
 #include "ColorRecognitionTCS230.h"
 #include <Arduino.h>
 #include <TimerOne.h>
+#if defined(TIMER5_OVF_vect)
+#include <avr/interrupt.h>
+#endif
+
+#ifndef digitalPinToInterrupt
+#define digitalPinToInterrupt(p) ((p) - 2)
+#endif
 
 ColorRecognitionTCS230 ColorRecognitionTCS230::instance;
 
-void ColorRecognitionTCS230::initialize(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin) {
+ColorRecognitionTCS230* ColorRecognitionTCS230::instances[MAX_INSTANCES];
+
+unsigned char ColorRecognitionTCS230::instanceCount = 0;
+
+ColorRecognitionTCS230* ColorRecognitionTCS230::interruptTable[EXTERNAL_INTERRUPTS];
+
+ColorRecognitionTCS230* ColorRecognitionTCS230::hardwareCounterInstance = 0;
+
+unsigned int ColorRecognitionTCS230::schedulerPeriod = DEFAULT_GATE_TIME_IN_MS;
+
+bool ColorRecognitionTCS230::initialize(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin) {
+    return initialize(outPin, s2Pin, s3Pin, NOT_WIRED, NOT_WIRED);
+}
+
+bool ColorRecognitionTCS230::initialize(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin,
+        unsigned char s0Pin, unsigned char s1Pin) {
+    unsigned char line = digitalPinToInterrupt(outPin);
+    if (line >= EXTERNAL_INTERRUPTS || hardwareCounter || oePin != NOT_WIRED) {
+        return false;
+    }
+    // The line belongs to another instance, or to a shared line.
+    if (interruptTable[line] != 0 && interruptTable[line] != this) {
+        return false;
+    }
+    this->interruptLine = line;
+    if (!registerInstance(outPin, s2Pin, s3Pin, s0Pin, s1Pin)) {
+        return false;
+    }
+    interruptTable[line] = this;
+    attachInterruptLine(line);
+    return true;
+}
+
+bool ColorRecognitionTCS230::initializeShared(unsigned char outPin, unsigned char oePin, unsigned char s2Pin,
+        unsigned char s3Pin, unsigned char s0Pin, unsigned char s1Pin) {
+    unsigned char line = digitalPinToInterrupt(outPin);
+    ColorRecognitionTCS230* owner;
+    if (line >= EXTERNAL_INTERRUPTS || hardwareCounter || oePin == NOT_WIRED) {
+        return false;
+    }
+    owner = interruptTable[line];
+    if (owner != 0 && owner->oePin == NOT_WIRED) {
+        return false;
+    }
+    this->interruptLine = line;
+    this->oePin = oePin;
+    pinMode(oePin, OUTPUT);
+    digitalWrite(oePin, HIGH);
+    if (owner == 0) {
+        // The line is not attached yet, so the first sensor is counted first.
+        interruptTable[line] = this;
+    }
+    if (!registerInstance(outPin, s2Pin, s3Pin, s0Pin, s1Pin)) {
+        if (owner == 0) {
+            interruptTable[line] = 0;
+        }
+        this->oePin = NOT_WIRED;
+        return false;
+    }
+    if (owner == 0) {
+        attachInterruptLine(line);
+    }
+    return true;
+}
+
+void ColorRecognitionTCS230::attachInterruptLine(unsigned char line) {
+    static void (* const handlers[EXTERNAL_INTERRUPTS])() = {
+        externalInterruptHandler0, externalInterruptHandler1, externalInterruptHandler2,
+        externalInterruptHandler3, externalInterruptHandler4, externalInterruptHandler5
+    };
+    attachInterrupt(line, handlers[line], RISING);
+}
+
+bool ColorRecognitionTCS230::initializeHardwareCounter(unsigned char s2Pin, unsigned char s3Pin,
+        unsigned char s0Pin, unsigned char s1Pin) {
+#if defined(TCCR5B)
+    unsigned char i;
+    for (i = 0; i < instanceCount && (instances[i] == this || !instances[i]->hardwareCounter); i++) {
+    }
+    if (i < instanceCount || interruptTable[interruptLine] == this || oePin != NOT_WIRED) {
+        return false;
+    }
+    TCCR5A = 0;
+    TCCR5B = 0;
+    TCNT5 = 0;
+    hardwareCounter = true;
+    if (!registerInstance(HARDWARE_COUNTER_PIN, s2Pin, s3Pin, s0Pin, s1Pin)) {
+        hardwareCounter = false;
+        return false;
+    }
+    hardwareCounterInstance = this;
+    TIFR5 = _BV(TOV5);
+    TIMSK5 |= _BV(TOIE5);
+    TCCR5B = _BV(CS52) | _BV(CS51) | _BV(CS50);
+    return true;
+#else
+    (void) s2Pin;
+    (void) s3Pin;
+    (void) s0Pin;
+    (void) s1Pin;
+    return false;
+#endif
+}
+
+bool ColorRecognitionTCS230::registerInstance(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin,
+        unsigned char s0Pin, unsigned char s1Pin) {
+    unsigned char i;
+    for (i = 0; i < instanceCount && instances[i] != this; i++) {
+    }
+    if (i == MAX_INSTANCES) {
+        return false;
+    }
     this->s2Pin = s2Pin;
     this->s3Pin = s3Pin;
+    this->s0Pin = s0Pin;
+    this->s1Pin = s1Pin;
     this->outPin = outPin;
-    this->currentFilter = CLEAR_FILTER;
+    if (s0Pin != NOT_WIRED && s1Pin != NOT_WIRED) {
+        pinMode(s0Pin, OUTPUT);
+        pinMode(s1Pin, OUTPUT);
+    } else {
+        this->s0Pin = NOT_WIRED;
+        this->s1Pin = NOT_WIRED;
+        setScaling(SCALING_2);
+    }
     pinMode(s2Pin, OUTPUT);
     pinMode(s3Pin, OUTPUT);
     pinMode(outPin, INPUT);
-    Timer1.initialize();
-    Timer1.attachInterrupt(ColorRecognitionTCS230::timerInterruptHandler);
-    attachInterrupt((outPin - 2), ColorRecognitionTCS230::externalInterruptHandler, RISING);
+    resolvePins();
+    noInterrupts();
+    instances[i] = this;
+    if (i == instanceCount) {
+        instanceCount++;
+    }
+    restartScheduler();
+    if (instanceCount > 1) {
+        // Reprogrammed along with the gates, so no overflow runs the 
+        // restarted gates at the old period.
+        Timer1.setPeriod(schedulerPeriod * 1000L);
+        Timer1.restart();
+    }
+    interrupts();
+    if (instanceCount == 1) {
+        Timer1.initialize(schedulerPeriod * 1000L);
+        Timer1.attachInterrupt(ColorRecognitionTCS230::timerInterruptHandler);
+    }
+    return true;
+}
+
+void ColorRecognitionTCS230::resolvePins() {
+    filterPort = resolvePort(s2Pin, s3Pin, &s2Mask, &s3Mask);
+    if (s0Pin != NOT_WIRED) {
+        scalingPort = resolvePort(s0Pin, s1Pin, &s0Mask, &s1Mask);
+    } else {
+        scalingPort = 0;
+    }
+}
+
+volatile unsigned char* ColorRecognitionTCS230::resolvePort(unsigned char pin1, unsigned char pin2,
+        unsigned char* mask1, unsigned char* mask2) {
+#if defined(portOutputRegister)
+    unsigned char port = digitalPinToPort(pin1);
+    if (port == NOT_A_PIN || port != digitalPinToPort(pin2)) {
+        return 0;
+    }
+    *mask1 = digitalPinToBitMask(pin1);
+    *mask2 = digitalPinToBitMask(pin2);
+    // Turns the PWM of the pins off, which the writes to the port do not.
+    digitalWrite(pin1, LOW);
+    digitalWrite(pin2, LOW);
+    return portOutputRegister(port);
+#else
+    (void) pin1;
+    (void) pin2;
+    (void) mask1;
+    (void) mask2;
+    return 0;
+#endif
+}
+
+ColorRecognitionTCS230::~ColorRecognitionTCS230() {
+    ColorRecognitionTCS230* next = this;
+    unsigned char i;
+    for (i = 0; i < instanceCount && instances[i] != this; i++) {
+    }
+    if (i == instanceCount) {
+        return;
+    }
+    if (hardwareCounter) {
+#if defined(TCCR5B)
+        TCCR5B = 0;
+        TIMSK5 &= ~_BV(TOIE5);
+        hardwareCounterInstance = 0;
+#endif
+    } else if (oePin != NOT_WIRED) {
+        digitalWrite(oePin, HIGH);
+    }
+    noInterrupts();
+    if (interruptTable[interruptLine] == this && !hardwareCounter) {
+        next = (oePin != NOT_WIRED) ? nextShared() : this;
+        if (next == this) {
+            detachInterrupt(interruptLine);
+            interruptTable[interruptLine] = 0;
+        } else {
+            interruptTable[interruptLine] = next;
+        }
+    }
+    instances[i] = instances[--instanceCount];
+    if (next != this) {
+        // The next sensor of the line starts its gate with all the others.
+        restartScheduler();
+        if (instanceCount > 0) {
+            Timer1.setPeriod(schedulerPeriod * 1000L);
+            Timer1.restart();
+        }
+    }
+    interrupts();
+    if (instanceCount == 0) {
+        Timer1.detachInterrupt();
+    }
 }
 
 void ColorRecognitionTCS230::adjustWhiteBalance() {
-    delay(4000);
-    instance.whiteBalanceFrequencies[0] = instance.lastFrequencies[0];
-    instance.whiteBalanceFrequencies[1] = instance.lastFrequencies[1];
-    instance.whiteBalanceFrequencies[2] = instance.lastFrequencies[2];
+    bool registered = false;
+    for (unsigned char i = 0; i < instanceCount; i++) {
+        if (instances[i] == this) {
+            registered = true;
+        }
+    }
+    if (!registered) {
+        return;
+    }
+    startWhiteBalance();
+    while (!updateWhiteBalance()) {
+        delay(1);
+    }
+}
+
+void ColorRecognitionTCS230::startWhiteBalance(unsigned char frames, WhiteBalanceCallback callback) {
+    ColorRecognitionFrame frame;
+    if (frames < WHITE_BALANCE_MIN_FRAMES) {
+        frames = WHITE_BALANCE_MIN_FRAMES;
+    }
+    readFrame(&frame);
+    // The next frame started before the call, so it is skipped.
+    balanceSequence = frame.sequence + 1;
+    balanceFrames = frames;
+    balanceCount = 0;
+    balanceProgress = 0;
+    balanceCallback = callback;
+    for (unsigned char i = 0; i < 4; i++) {
+        balanceSums[i] = 0;
+        balanceAverages[i] = 0;
+    }
+    balancing = true;
+}
+
+bool ColorRecognitionTCS230::updateWhiteBalance() {
+    ColorRecognitionFrame frame;
+    bool stable = true;
+    long average, change;
+    if (!balancing) {
+        return true;
+    }
+    if (!readFrame(&frame) || frame.sequence <= balanceSequence) {
+        return false;
+    }
+    balanceSequence = frame.sequence;
+    balanceCount++;
+    for (unsigned char i = 0; i < 4; i++) {
+        balanceSums[i] += frame.frequencies[i];
+        average = balanceSums[i] / balanceCount;
+        if (balanceCount < WHITE_BALANCE_MIN_FRAMES) {
+            stable = false;
+        } else {
+            change = average - balanceAverages[i];
+            if (change < 0) {
+                change = -change;
+            }
+            if ((change << WHITE_BALANCE_STABILITY_SHIFT) > balanceAverages[i]) {
+                stable = false;
+            }
+        }
+        balanceAverages[i] = average;
+    }
+    if (stable || balanceCount >= balanceFrames) {
+        whiteBalance.setWhite(0, balanceAverages[0]);
+        whiteBalance.setWhite(1, balanceAverages[1]);
+        whiteBalance.setWhite(2, balanceAverages[2]);
+        if (balanceAverages[3] != 0) {
+            whiteBalance.setWhite(3, balanceAverages[3]);
+        }
+        balancing = false;
+        balanceProgress = 100;
+    } else {
+        balanceProgress = (unsigned int) balanceCount * 100 / balanceFrames;
+    }
+    if (balanceCallback != 0) {
+        balanceCallback(balanceProgress);
+    }
+    return !balancing;
+}
+
+bool ColorRecognitionTCS230::isBalancing() {
+    return balancing;
+}
+
+unsigned char ColorRecognitionTCS230::getWhiteBalanceProgress() {
+    return balanceProgress;
+}
+
+void ColorRecognitionTCS230::saveCalibration(int address) {
+    ColorRecognitionCalibration calibration(CALIBRATION_DRIVER_TCS230);
+    calibration.setScale(&whiteBalance);
+    for (unsigned char i = 0; i < 4; i++) {
+        calibration.scalings[i] = scalings[i];
+        calibration.gateTimes[i] = gateTimes[i];
+    }
+    if (autoRange) {
+        calibration.options |= CALIBRATION_AUTO_RANGE;
+    }
+    if (adaptiveGate) {
+        calibration.options |= CALIBRATION_ADAPTIVE_GATE;
+    }
+    if (schedule == RGBC_SCHEDULE) {
+        calibration.options |= CALIBRATION_RGBC_SCHEDULE;
+    }
+    calibration.save(address);
+}
+
+bool ColorRecognitionTCS230::loadCalibration(int address) {
+    ColorRecognitionCalibration calibration(CALIBRATION_DRIVER_TCS230);
+    if (!calibration.load(address)) {
+        return false;
+    }
+    noInterrupts();
+    calibration.applyScale(&whiteBalance);
+    for (unsigned char i = 0; i < 4; i++) {
+        // Without the s0 and s1 pins the sensor is fixed at 2%.
+        scalings[i] = (s0Pin == NOT_WIRED) ? SCALING_2 : (Scaling) calibration.scalings[i];
+        setGateTime((Filter) i, calibration.gateTimes[i]);
+    }
+    schedule = (calibration.options & CALIBRATION_RGBC_SCHEDULE) ? RGBC_SCHEDULE : RGB_SCHEDULE;
+    autoRange = (calibration.options & CALIBRATION_AUTO_RANGE) && s0Pin != NOT_WIRED;
+    interrupts();
+    if (calibration.options & CALIBRATION_ADAPTIVE_GATE) {
+        enableAdaptiveGate();
+    } else {
+        disableAdaptiveGate();
+    }
+    return true;
+}
+
+void ColorRecognitionTCS230::counterOverflowHandler() {
+    if (hardwareCounterInstance != 0) {
+        hardwareCounterInstance->count += 0x10000UL;
+#if COLOR_RECOGNITION_STATISTICS
+        hardwareCounterInstance->driverStatistics.counterOverflows++;
+#endif
+    }
+}
+
+void ColorRecognitionTCS230::externalInterruptHandler0() {
+    interruptTable[0]->count++;
+}
+
+void ColorRecognitionTCS230::externalInterruptHandler1() {
+    interruptTable[1]->count++;
+}
+
+void ColorRecognitionTCS230::externalInterruptHandler2() {
+    interruptTable[2]->count++;
+}
+
+void ColorRecognitionTCS230::externalInterruptHandler3() {
+    interruptTable[3]->count++;
 }
 
-void ColorRecognitionTCS230::externalInterruptHandler() {
-    instance.count++;
+void ColorRecognitionTCS230::externalInterruptHandler4() {
+    interruptTable[4]->count++;
+}
+
+void ColorRecognitionTCS230::externalInterruptHandler5() {
+    interruptTable[5]->count++;
+}
+
+void ColorRecognitionTCS230::restartScheduler() {
+    schedulerPeriod = MAX_GATE_TIME_IN_MS;
+    for (unsigned char i = 0; i < instanceCount; i++) {
+        ColorRecognitionTCS230* sensor = instances[i];
+        sensor->setFilter(RED_FILTER);
+        if (sensor->oePin != NOT_WIRED) {
+            // Each shared line starts over from the sensor holding it.
+            digitalWrite(sensor->oePin, sensor->isIdle() ? HIGH : LOW);
+            sensor->handedOver = false;
+        }
+        sensor->settleGate();
+        if (!sensor->isIdle() && sensor->remainingGateTime < schedulerPeriod) {
+            schedulerPeriod = sensor->remainingGateTime;
+        }
+    }
 }
 
 void ColorRecognitionTCS230::timerInterruptHandler() {
-    switch (instance.currentFilter) {
-    case CLEAR_FILTER:
-        setFilter(RED_FILTER);
-        break;
+#if COLOR_RECOGNITION_STATISTICS
+    unsigned long start = micros();
+    unsigned int duration;
+#endif
+    unsigned int elapsed = schedulerPeriod;
+    schedulerPeriod = MAX_GATE_TIME_IN_MS;
+    for (unsigned char i = 0; i < instanceCount; i++) {
+        ColorRecognitionTCS230* sensor = instances[i];
+        if (sensor->isIdle() || sensor->handedOver) {
+            continue;
+        }
+        if (sensor->remainingGateTime > elapsed) {
+            sensor->remainingGateTime -= elapsed;
+        } else if (sensor->settling) {
+            sensor->startGate();
+        } else {
+            sensor->nextGate();
+        }
+    }
+    // A gate handed over may belong to a sensor already passed above, so the
+    // next period is only taken when all the gates are settled.
+    for (unsigned char i = 0; i < instanceCount; i++) {
+        ColorRecognitionTCS230* sensor = instances[i];
+        if (sensor->isIdle()) {
+            continue;
+        }
+        sensor->handedOver = false;
+        if (sensor->remainingGateTime < schedulerPeriod) {
+            schedulerPeriod = sensor->remainingGateTime;
+        }
+    }
+    Timer1.setPeriod(schedulerPeriod * 1000L);
+#if COLOR_RECOGNITION_STATISTICS
+    duration = (unsigned int) (micros() - start);
+    for (unsigned char i = 0; i < instanceCount; i++) {
+        ColorRecognitionStatistics* statistics = &instances[i]->driverStatistics;
+        if (duration < statistics->minInterruptTime) {
+            statistics->minInterruptTime = duration;
+        }
+        if (duration > statistics->maxInterruptTime) {
+            statistics->maxInterruptTime = duration;
+        }
+    }
+#endif
+}
+
+void ColorRecognitionTCS230::nextGate() {
+    Filter filter = currentFilter;
+    Scaling scaling = currentScaling;
+    ColorRecognitionTCS230* next = (oePin != NOT_WIRED) ? nextShared() : this;
+    unsigned long count = readCount();
+    if (next == this && settleTime == 0) {
+        // The next gate counts from here, so the edges that come while the 
+        // gate that ended is computed are not lost to it.
+        clearCount();
+    }
+    switch (filter) {
     case RED_FILTER:
-        instance.lastFrequencies[0] = instance.count;
         setFilter(GREEN_FILTER);
         break;
     case GREEN_FILTER:
-        instance.lastFrequencies[1] = instance.count;
         setFilter(BLUE_FILTER);
         break;
     case BLUE_FILTER:
-        instance.lastFrequencies[2] = instance.count;
+        setFilter(schedule == RGBC_SCHEDULE ? CLEAR_FILTER : RED_FILTER);
+        break;
+    case CLEAR_FILTER:
         setFilter(RED_FILTER);
         break;
     }
-    instance.count = 0;
-    Timer1.setPeriod(1000000);
+    // The next filter settles while the gate that ended is computed.
+    endGate(filter, count, scaling);
+    if (currentFilter == RED_FILTER) {
+        if (filter == BLUE_FILTER) {
+            lastFrequencies[3] = 0;
+        }
+        publishFrame();
+    }
+    if (next != this) {
+        handOver(next);
+    } else if (settleTime == 0) {
+        startGate(false);
+    } else {
+        settleGate();
+    }
 }
 
-unsigned char ColorRecognitionTCS230::getRed() {
-    if (lastFrequencies[0] > whiteBalanceFrequencies[0]) {
-        return 255;
+void ColorRecognitionTCS230::settleGate() {
+    if (settleTime == 0) {
+        startGate();
+        return;
     }
-    return (unsigned char) map(lastFrequencies[0], 0, whiteBalanceFrequencies[0], 0, 255);
+    settling = true;
+    remainingGateTime = settleTime;
 }
 
-unsigned char ColorRecognitionTCS230::getGreen() {
-    if (lastFrequencies[1] > whiteBalanceFrequencies[1]) {
-        return 255;
+void ColorRecognitionTCS230::startGate(bool clear) {
+    settling = false;
+    if (clear) {
+        clearCount();
     }
-    return (unsigned char) map(lastFrequencies[1], 0, whiteBalanceFrequencies[1], 0, 255);
+    currentGateTime = gateTimes[currentFilter];
+    remainingGateTime = currentGateTime;
+#if COLOR_RECOGNITION_STATISTICS
+    gateStart = micros();
+#endif
 }
 
-unsigned char ColorRecognitionTCS230::getBlue() {
-    if (lastFrequencies[2] > whiteBalanceFrequencies[2]) {
-        return 255;
+bool ColorRecognitionTCS230::isIdle() {
+    return oePin != NOT_WIRED && interruptTable[interruptLine] != this;
+}
+
+ColorRecognitionTCS230* ColorRecognitionTCS230::nextShared() {
+    unsigned char i, j, k;
+    for (i = 0; i < instanceCount && instances[i] != this; i++) {
+    }
+    for (j = 1; j < instanceCount; j++) {
+        k = i + j;
+        if (k >= instanceCount) {
+            k -= instanceCount;
+        }
+        if (instances[k]->oePin != NOT_WIRED && instances[k]->interruptLine == interruptLine) {
+            return instances[k];
+        }
+    }
+    return this;
+}
+
+void ColorRecognitionTCS230::handOver(ColorRecognitionTCS230* next) {
+    // The filter of the next sensor was switched at the end of its last 
+    // gate, so it is settled and counted at once.
+    digitalWrite(oePin, HIGH);
+    interruptTable[interruptLine] = next;
+    digitalWrite(next->oePin, LOW);
+    next->startGate();
+    next->handedOver = true;
+}
+
+unsigned long ColorRecognitionTCS230::readCount() {
+#if defined(TCCR5B)
+    if (hardwareCounter) {
+        // Called by the scheduler with the interrupts disabled: a wrap not
+        // handled yet is pending in TOV5, and a low TCNT5 was read after it.
+        unsigned int low = TCNT5;
+        if ((TIFR5 & _BV(TOV5)) && low < 0x8000) {
+            return count + 0x10000UL + low;
+        }
+        return count + low;
+    }
+#endif
+    return count;
+}
+
+void ColorRecognitionTCS230::clearCount() {
+#if defined(TCCR5B)
+    if (hardwareCounter) {
+        TCNT5 = 0;
+        TIFR5 = _BV(TOV5);
+    }
+#endif
+    count = 0;
+}
+
+void ColorRecognitionTCS230::publishFrame() {
+    unsigned char head = frameBufferHead;
+    if (frameFilter != 0) {
+        frameFilter->apply(lastFrequencies, 4);
+    }
+    if (changeDetector != 0) {
+        changeDetector->update(lastFrequencies, 4);
+    }
+    frameVersion++;
+    frame.sequence++;
+    frame.timestamp = micros();
+    frame.frequencies[0] = lastFrequencies[0];
+    frame.frequencies[1] = lastFrequencies[1];
+    frame.frequencies[2] = lastFrequencies[2];
+    frame.frequencies[3] = lastFrequencies[3];
+    frameVersion++;
+#if COLOR_RECOGNITION_STATISTICS
+    for (unsigned char i = 0; i < 4; i++) {
+        if (lastFrequencies[i] != 0 && lastFrequencies[i] >= whiteBalance.getWhite(i)) {
+            driverStatistics.saturations++;
+        }
+    }
+#endif
+    if ((unsigned char) (head - frameBufferTail) >= FRAME_BUFFER_SIZE) {
+        frameBufferOverruns++;
+#if COLOR_RECOGNITION_STATISTICS
+        driverStatistics.overruns++;
+#endif
+        return;
+    }
+    copyFrame(&frameBuffer[head & (FRAME_BUFFER_SIZE - 1)], &frame);
+    frameBufferHead = head + 1;
+}
+
+void ColorRecognitionTCS230::copyFrame(volatile ColorRecognitionFrame* to, volatile ColorRecognitionFrame* from) {
+    to->sequence = from->sequence;
+    to->timestamp = from->timestamp;
+    to->frequencies[0] = from->frequencies[0];
+    to->frequencies[1] = from->frequencies[1];
+    to->frequencies[2] = from->frequencies[2];
+    to->frequencies[3] = from->frequencies[3];
+}
+
+bool ColorRecognitionTCS230::readFrame(ColorRecognitionFrame* frame) {
+    unsigned char version;
+    do {
+        version = frameVersion;
+        copyFrame(frame, &this->frame);
+    } while ((version & 1) || version != frameVersion);
+    return frame->sequence != 0;
+}
+
+unsigned char ColorRecognitionTCS230::drain(ColorRecognitionFrame* frames, unsigned char n) {
+    unsigned char tail = frameBufferTail;
+    unsigned char buffered = frameBufferHead - tail;
+    if (n > buffered) {
+        n = buffered;
+    }
+    for (unsigned char i = 0; i < n; i++) {
+        copyFrame(&frames[i], &frameBuffer[(unsigned char) (tail + i) & (FRAME_BUFFER_SIZE - 1)]);
+    }
+    frameBufferTail = tail + n;
+    return n;
+}
+
+#if COLOR_RECOGNITION_STATISTICS
+void ColorRecognitionTCS230::getStatistics(ColorRecognitionStatistics* statistics) {
+    noInterrupts();
+    *statistics = driverStatistics;
+    interrupts();
+}
+
+void ColorRecognitionTCS230::resetStatistics() {
+    noInterrupts();
+    clearDriverStatistics();
+    interrupts();
+}
+
+void ColorRecognitionTCS230::clearDriverStatistics() {
+    driverStatistics.since = micros();
+    driverStatistics.edges = 0;
+    driverStatistics.measures = 0;
+    driverStatistics.timeouts = 0;
+    driverStatistics.saturations = 0;
+    driverStatistics.overruns = 0;
+    driverStatistics.counterOverflows = 0;
+    driverStatistics.maxJitter = 0;
+    driverStatistics.minInterruptTime = 0xffff;
+    driverStatistics.maxInterruptTime = 0;
+}
+#endif
+
+unsigned char ColorRecognitionTCS230::available() {
+    return frameBufferHead - frameBufferTail;
+}
+
+unsigned int ColorRecognitionTCS230::getOverruns() {
+    unsigned int overruns;
+    do {
+        overruns = frameBufferOverruns;
+    } while (overruns != frameBufferOverruns);
+    return overruns;
+}
+
+void ColorRecognitionTCS230::endGate(Filter filter, unsigned long count, Scaling scaling) {
+    unsigned char percentage = getScalingPercentage(scaling);
+    unsigned char nextPercentage;
+    unsigned long gateTime;
+#if COLOR_RECOGNITION_STATISTICS
+    unsigned long jitter = micros() - gateStart;
+    jitter = (jitter > currentGateTime * 1000UL) ? jitter - currentGateTime * 1000UL : currentGateTime * 1000UL - jitter;
+    if (jitter > driverStatistics.maxJitter) {
+        driverStatistics.maxJitter = (jitter > 0xffff) ? 0xffff : (unsigned int) jitter;
+    }
+    driverStatistics.edges += count;
+    driverStatistics.measures++;
+    if (count == 0) {
+        driverStatistics.timeouts++;
+    }
+#endif
+    lastCounts[filter] = count;
+    if (percentage == 0) {
+        lastFrequencies[filter] = 0;
+    } else {
+        lastFrequencies[filter] = toFrequency(count, 1000UL * (100 / percentage));
+    }
+    if (autoRange) {
+        adjustRange(filter, toFrequency(count, 1000UL));
+    }
+    if (adaptiveGate) {
+        if (count == 0) {
+            gateTime = maxGateTime;
+        } else {
+            gateTime = ((currentGateTime * (unsigned long) targetCount) + count - 1) / count;
+            nextPercentage = getScalingPercentage(scalings[filter]);
+            if (nextPercentage != 0 && nextPercentage != percentage) {
+                gateTime = (gateTime * percentage + nextPercentage - 1) / nextPercentage;
+            }
+        }
+        if (gateTime < minGateTime) {
+            gateTime = minGateTime;
+        } else if (gateTime > maxGateTime) {
+            gateTime = maxGateTime;
+        }
+        gateTimes[filter] = (unsigned int) gateTime;
+    }
+}
+
+void ColorRecognitionTCS230::adjustRange(Filter filter, long frequency) {
+    Scaling scaling = scalings[filter];
+    if (scaling == POWER_DOWN) {
+        return;
+    }
+    if (frequency > AUTO_RANGE_MAX_FREQUENCY) {
+        if (scaling > SCALING_2) {
+            scalings[filter] = (Scaling) (scaling - 1);
+        }
+    } else if (scaling < SCALING_100) {
+        frequency = frequency * getScalingPercentage((Scaling) (scaling + 1)) / getScalingPercentage(scaling);
+        if (frequency < AUTO_RANGE_MAX_FREQUENCY - AUTO_RANGE_MAX_FREQUENCY / 4) {
+            scalings[filter] = (Scaling) (scaling + 1);
+        }
+    }
+}
+
+void ColorRecognitionTCS230::setScaling(Scaling scaling) {
+    if (s0Pin == NOT_WIRED && scaling != SCALING_2) {
+        return;
+    }
+    autoRange = false;
+    scalings[0] = scaling;
+    scalings[1] = scaling;
+    scalings[2] = scaling;
+    scalings[3] = scaling;
+}
+
+ColorRecognitionTCS230::Scaling ColorRecognitionTCS230::getScaling(Filter filter) {
+    return scalings[filter];
+}
+
+void ColorRecognitionTCS230::enableAutoRange() {
+    if (s0Pin != NOT_WIRED) {
+        autoRange = true;
+    }
+}
+
+void ColorRecognitionTCS230::disableAutoRange() {
+    autoRange = false;
+}
+
+void ColorRecognitionTCS230::setFrameFilter(ColorRecognitionFrameFilter* filter) {
+    noInterrupts();
+    if (filter != 0) {
+        filter->resetChain();
+    }
+    frameFilter = filter;
+    interrupts();
+}
+
+void ColorRecognitionTCS230::setChangeDetector(ColorRecognitionChangeDetector* detector) {
+    noInterrupts();
+    if (detector != 0) {
+        detector->reset();
+    }
+    changeDetector = detector;
+    interrupts();
+}
+
+unsigned char ColorRecognitionTCS230::getScalingPercentage(Scaling scaling) {
+    switch (scaling) {
+    case SCALING_2:
+        return 2;
+    case SCALING_20:
+        return 20;
+    case SCALING_100:
+        return 100;
+    default:
+        return 0;
+    }
+}
+
+void ColorRecognitionTCS230::setGateTime(unsigned int gateTime) {
+    setGateTime(RED_FILTER, gateTime);
+    setGateTime(GREEN_FILTER, gateTime);
+    setGateTime(BLUE_FILTER, gateTime);
+    setGateTime(CLEAR_FILTER, gateTime);
+}
+
+void ColorRecognitionTCS230::setGateTime(Filter filter, unsigned int gateTime) {
+    if (gateTime < MIN_GATE_TIME_IN_MS) {
+        gateTime = MIN_GATE_TIME_IN_MS;
+    } else if (gateTime > MAX_GATE_TIME_IN_MS) {
+        gateTime = MAX_GATE_TIME_IN_MS;
     }
-    return (unsigned char) map(lastFrequencies[2], 0, whiteBalanceFrequencies[2], 0, 255);
+    gateTimes[filter] = gateTime;
+}
+
+unsigned int ColorRecognitionTCS230::getGateTime(Filter filter) {
+    return gateTimes[filter];
+}
+
+void ColorRecognitionTCS230::setSettleTime(unsigned int settleTime) {
+    if (settleTime > MAX_GATE_TIME_IN_MS) {
+        settleTime = MAX_GATE_TIME_IN_MS;
+    }
+    this->settleTime = settleTime;
+}
+
+unsigned int ColorRecognitionTCS230::getSettleTime() {
+    return settleTime;
+}
+
+void ColorRecognitionTCS230::enableAdaptiveGate(unsigned int targetCount, unsigned int minGateTime,
+        unsigned int maxGateTime) {
+    if (minGateTime < MIN_GATE_TIME_IN_MS) {
+        minGateTime = MIN_GATE_TIME_IN_MS;
+    }
+    if (maxGateTime > MAX_GATE_TIME_IN_MS) {
+        maxGateTime = MAX_GATE_TIME_IN_MS;
+    }
+    if (maxGateTime < minGateTime) {
+        maxGateTime = minGateTime;
+    }
+    this->targetCount = targetCount;
+    this->minGateTime = minGateTime;
+    this->maxGateTime = maxGateTime;
+    adaptiveGate = true;
+}
+
+void ColorRecognitionTCS230::disableAdaptiveGate() {
+    adaptiveGate = false;
+}
+
+void ColorRecognitionTCS230::setSchedule(Schedule schedule) {
+    this->schedule = schedule;
+}
+
+ColorRecognitionTCS230::Schedule ColorRecognitionTCS230::getSchedule() {
+    return schedule;
+}
+
+unsigned long ColorRecognitionTCS230::getFramePeriod() {
+    unsigned long period = 0;
+    if (oePin == NOT_WIRED || nextShared() == this) {
+        return getGatesTime() + getSettlesTime();
+    }
+    for (unsigned char i = 0; i < instanceCount; i++) {
+        if (instances[i]->oePin != NOT_WIRED && instances[i]->interruptLine == interruptLine) {
+            period += instances[i]->getGatesTime();
+        }
+    }
+    return period;
+}
+
+unsigned long ColorRecognitionTCS230::getGatesTime() {
+    unsigned long time = (unsigned long) gateTimes[0] + gateTimes[1] + gateTimes[2];
+    if (schedule == RGBC_SCHEDULE) {
+        time += gateTimes[3];
+    }
+    return time;
+}
+
+unsigned long ColorRecognitionTCS230::getSettlesTime() {
+    return (unsigned long) settleTime * (schedule == RGBC_SCHEDULE ? 4 : 3);
+}
+
+float ColorRecognitionTCS230::getFrameRate() {
+    return 1000.0 / getFramePeriod();
+}
+
+long ColorRecognitionTCS230::toFrequency(unsigned long count, unsigned long multiplier) {
+    // The count of a long gate times the multiplier overflows 32 bits, so the
+    // whole gate periods and the remainder are multiplied apart.
+    return (count / currentGateTime) * multiplier + ((count % currentGateTime) * multiplier) / currentGateTime;
+}
+
+unsigned long ColorRecognitionTCS230::getResolution(Filter filter) {
+    return lastCounts[filter];
+}
+
+unsigned char ColorRecognitionTCS230::getIntensity(Filter filter, long frequency) {
+    return whiteBalance.toIntensity(filter, frequency);
+}
+
+unsigned char ColorRecognitionTCS230::getRed() {
+    ColorRecognitionFrame frame;
+    readFrame(&frame);
+    return getIntensity(RED_FILTER, frame.frequencies[0]);
+}
+
+unsigned char ColorRecognitionTCS230::getGreen() {
+    ColorRecognitionFrame frame;
+    readFrame(&frame);
+    return getIntensity(GREEN_FILTER, frame.frequencies[1]);
+}
+
+unsigned char ColorRecognitionTCS230::getBlue() {
+    ColorRecognitionFrame frame;
+    readFrame(&frame);
+    return getIntensity(BLUE_FILTER, frame.frequencies[2]);
 }
 
 bool ColorRecognitionTCS230::fillRGB(unsigned char buf[3]) {
-    buf[0] = getRed();
-    buf[1] = getGreen();
-    buf[2] = getBlue();
+    ColorRecognitionFrame frame;
+    bool acquired = readFrame(&frame);
+    whiteBalance.toIntensities(frame.frequencies, buf);
+    return acquired;
+}
+
+bool ColorRecognitionTCS230::fillRGB16(unsigned int buf[3]) {
+    ColorRecognitionFrame frame;
+    bool acquired = readFrame(&frame);
+    whiteBalance.toIntensities16(frame.frequencies, buf);
+    return acquired;
+}
+
+bool ColorRecognitionTCS230::fillFrequencies(long buf[3]) {
+    ColorRecognitionFrame frame;
+    bool acquired = readFrame(&frame);
+    buf[0] = frame.frequencies[0];
+    buf[1] = frame.frequencies[1];
+    buf[2] = frame.frequencies[2];
+    return acquired;
+}
+
+unsigned char ColorRecognitionTCS230::getClear() {
+    ColorRecognitionFrame frame;
+    readFrame(&frame);
+    return getIntensity(CLEAR_FILTER, frame.frequencies[3]);
+}
+
+bool ColorRecognitionTCS230::fillChromaticity(unsigned char buf[3]) {
+    ColorRecognitionFrame frame;
+    unsigned long factor;
+    readFrame(&frame);
+    if (frame.frequencies[3] <= 0) {
+        buf[0] = buf[1] = buf[2] = 0;
+        return false;
+    }
+    factor = (255UL << SCALE_FRACTION_BITS) / frame.frequencies[3];
+    for (unsigned char i = 0; i < 3; i++) {
+        if (frame.frequencies[i] >= frame.frequencies[3]) {
+            buf[i] = 255;
+        } else {
+            buf[i] = (unsigned char) ((frame.frequencies[i] * factor) >> SCALE_FRACTION_BITS);
+        }
+    }
     return true;
 }
 
 void ColorRecognitionTCS230::setFilter(Filter filter) {
     unsigned char s2 = LOW, s3 = LOW;
-    instance.currentFilter = filter;
+    currentFilter = filter;
     if (filter == CLEAR_FILTER || filter == GREEN_FILTER) {
         s2 = HIGH;
     }
     if (filter == BLUE_FILTER || filter == GREEN_FILTER) {
         s3 = HIGH;
     }
-    digitalWrite(instance.s2Pin, s2);
-    digitalWrite(instance.s3Pin, s3);
+    if (filterPort != 0) {
+        *filterPort = (*filterPort & ~(s2Mask | s3Mask)) | (s2 == HIGH ? s2Mask : 0) | (s3 == HIGH ? s3Mask : 0);
+    } else {
+        digitalWrite(s2Pin, s2);
+        digitalWrite(s3Pin, s3);
+    }
+    currentScaling = getScaling(filter);
+    applyScaling(currentScaling);
+}
+
+void ColorRecognitionTCS230::applyScaling(Scaling scaling) {
+    unsigned char s0 = (scaling == SCALING_20 || scaling == SCALING_100) ? HIGH : LOW;
+    unsigned char s1 = (scaling == SCALING_2 || scaling == SCALING_100) ? HIGH : LOW;
+    if (s0Pin == NOT_WIRED) {
+        return;
+    }
+    if (scalingPort != 0) {
+        *scalingPort = (*scalingPort & ~(s0Mask | s1Mask)) | (s0 == HIGH ? s0Mask : 0) | (s1 == HIGH ? s1Mask : 0);
+    } else {
+        digitalWrite(s0Pin, s0);
+        digitalWrite(s1Pin, s1);
+    }
+}
+
+#if defined(TIMER5_OVF_vect)
+ISR(TIMER5_OVF_vect) {
+    ColorRecognitionTCS230::counterOverflowHandler();
 }
+#endif
 
 #endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_CPP__ */
@@ -12,10 +12,18 @@
 #define __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_H__ 1
 
 #include <ColorRecognition.h>
+#include <ColorRecognitionFrame.h>
+#include <ColorRecognitionScale.h>
+#include <ColorRecognitionFrameFilter.h>
+#include <ColorRecognitionChangeDetector.h>
+#include <ColorRecognitionCalibration.h>
+#include <ColorRecognitionStatistics.h>
 
 /**
- * In this driver we are assuming the S0 pin is LOW and S1 pin is HIGH. With
- * output frequency at 2%. It saves arduino pins also.
+ * When the S0 and S1 pins are not given to the driver, we are assuming the S0
+ * pin is LOW and S1 pin is HIGH. With output frequency at 2%. It saves arduino
+ * pins also. When they are given, the scaling can be selected, or picked for
+ * each filter by the auto ranging.
  * 
  * <pre>
  * S0   S1  OUTPUT FREQUENCY
@@ -91,7 +99,168 @@
  */
 #define MAX_FRQUENCY_IN_HZ 1000
 
+/**
+ * Marks the S0 and S1 pins as not wired to the arduino.
+ */
+#ifndef NOT_WIRED
+#define NOT_WIRED 0xff
+#endif
+
+/**
+ * The highest out pin frequency, in Hz, the auto ranging lets through. Each 
+ * edge costs one external interrupt, so it bounds the interrupt load.
+ */
+#ifndef AUTO_RANGE_MAX_FREQUENCY
+#define AUTO_RANGE_MAX_FREQUENCY 10000
+#endif
+
+/**
+ * The default gate time of each filter, in milliseconds.
+ */
+#define DEFAULT_GATE_TIME_IN_MS 1000
+
+/**
+ * The gate time limits, in milliseconds. The upper limit is bounded by the 
+ * longest period TimerOne can generate (about 8.3 seconds at 16MHz).
+ */
+#define MIN_GATE_TIME_IN_MS 1
+#define MAX_GATE_TIME_IN_MS 8000
+
+/**
+ * The default settle time after each filter switch, in milliseconds (see
+ * Filter settling).
+ */
+#ifndef DEFAULT_SETTLE_TIME_IN_MS
+#define DEFAULT_SETTLE_TIME_IN_MS 0
+#endif
+
+/**
+ * The default number of counts the adaptive gate aims for. 256 counts per gate
+ * are enough to resolve the full 8 bits of each color intensity.
+ */
+#define DEFAULT_TARGET_COUNT 256
+
+/**
+ * The default maximum number of frames averaged by the white balance, and 
+ * the minimum it averages before checking if the average is stable.
+ */
+#define WHITE_BALANCE_FRAMES 8
+#define WHITE_BALANCE_MIN_FRAMES 2
+
+/**
+ * The white balance average is stable when a new frame moves it by at most
+ * 1/2^WHITE_BALANCE_STABILITY_SHIFT on every channel (1/512 is half an 
+ * intensity step at white).
+ */
+#define WHITE_BALANCE_STABILITY_SHIFT 9
+
+/**
+ * The maximum number of driver instances served by the shared scheduler.
+ */
+#ifndef MAX_INSTANCES
+#define MAX_INSTANCES 8
+#endif
+
+/**
+ * The number of external interrupt lines of the dispatch table (6 on the
+ * Arduino Mega, only the first 2 exist on the ATmega328P boards).
+ */
+#define EXTERNAL_INTERRUPTS 6
+
+/**
+ * Hardware counting:
+ * 
+ * With the out pin wired to the T5 pin of the Arduino Mega (digital pin 47),
+ * an instance can be initialized with initializeHardwareCounter(). Timer5 is
+ * then clocked by the rising edges of the out pin and counts them by itself,
+ * and the scheduler reads and clears it at the end of each gate. It takes one
+ * interrupt per gate instead of one per pulse, so the sensor can run at the
+ * 20% and 100% scalings without loading the CPU.
+ * 
+ * Timer5 is 16 bits, so its overflow interrupt adds 65536 to the count each
+ * time it wraps (about every 100ms at 600KHz), which takes one interrupt per
+ * 65536 pulses and keeps the longest gates exact. The other boards have no 
+ * free timer with an external clock pin besides Timer1, which is the gate 
+ * timer, so there it is not available.
+ */
+#define HARDWARE_COUNTER_PIN 47
+
+/**
+ * Fast pin switching:
+ * 
+ * The scheduler switches the filter (and the scaling) of each sensor inside
+ * the Timer1 interrupt. digitalWrite() looks the port and the bit of the pin
+ * up in the flash on each call, so the ports and the bit masks of the s2 
+ * and s3 pins, and of the s0 and s1 pins, are resolved once by initialize().
+ * When both pins of a pair are on the same port, they are switched together
+ * with one write to the port, otherwise with digitalWrite().
+ * 
+ * NOTE: Wiring S2 and S3 to the same port (for instance, digital pins 22 to
+ * 29, the port A of the Arduino Mega) gives the shortest interrupt.
+ */
+
+/**
+ * Shared out line:
+ * 
+ * The OUT pin of the TCS230 is high impedance while OE is HIGH, so the out
+ * pins of several sensors can be wired together to one external interrupt 
+ * pin, each sensor with its own OE pin, and initialized with 
+ * initializeShared(). The sensors of the line take turns, one gate each: at
+ * the end of a gate the scheduler disables the sensor, moves the interrupt
+ * line to the next sensor and enables it. So the line takes one interrupt 
+ * pin for all of them, and the sensors can be mixed with the ones of other
+ * lines.
+ * 
+ * Each sensor switches to its next filter when its gate ends, and only 
+ * counts again after the gates of all the other sensors of the line, so the
+ * filter switch settles while the others are counted, without a dead time.
+ * That needs the s2 and s3 pins (and s0 and s1, when wired) of each sensor
+ * on their own pins. With a single sensor on the line there is nothing to 
+ * overlap with, as with initialize().
+ * 
+ * NOTE: Enabling a sensor while its output is HIGH makes a rising edge on
+ * the line, which may add one count to its gate, the same as the +-1 count
+ * error of any gate.
+ */
+
+/**
+ * Filter settling:
+ * 
+ * After S2, S3 (or S0, S1) switch, the out pin takes up to one period of the
+ * new frequency to follow the new photodiodes, and the edges meanwhile still
+ * belong to the old ones. A gate started at once counts them, which is a 
+ * bias of about one count per gate: invisible on 1 second gates, but a few 
+ * percent on gates of a few milliseconds. With setSettleTime(), the 
+ * scheduler waits the settle time after each switch, and the pulses counted
+ * meanwhile are discarded, before the gate starts.
+ * 
+ * The scheduler switches to the next filter as soon as a gate ends, and 
+ * computes the frequencies, the frame filter and the change detector of 
+ * the gate while the sensor settles. One period of the slowest filter is 
+ * enough: 3ms at the 2% scaling for a 400Hz output.
+ * 
+ * On a shared out line, the sensors settle while the others are counted, so
+ * the settle time only applies to a sensor alone on its line.
+ */
+
+/**
+ * The capacity, in frames, of the ring buffer of each instance. It must be a
+ * power of two, up to 128.
+ */
+#ifndef FRAME_BUFFER_SIZE
+#define FRAME_BUFFER_SIZE 8
+#endif
+
 class ColorRecognitionTCS230: public ColorRecognition {
+public:
+
+    /**
+     * The white balance progress callback. It is called from 
+     * updateWhiteBalance(), not from the interrupt, with the progress from
+     * 0 to 100, which means done.
+     */
+    typedef void (*WhiteBalanceCallback)(unsigned char progress);
+
 private:
 
     /**
@@ -104,33 +273,207 @@ private:
      */
     unsigned char s3Pin;
 
+    /**
+     * The s0 pin, NOT_WIRED if fixed by the wiring.
+     */
+    unsigned char s0Pin;
+
+    /**
+     * The s1 pin, NOT_WIRED if fixed by the wiring.
+     */
+    unsigned char s1Pin;
+
     /**
      * The out pin.
      * 
-     * NOTE: It must be the 2 or 3 pin to support external interrupts.
+     * NOTE: It must be an external interrupt pin.
      */
     unsigned char outPin;
 
     /**
-     * Holds the number of interrupts of the current filter.
+     * The OE pin, NOT_WIRED unless the out pin is shared.
+     */
+    unsigned char oePin;
+
+    /**
+     * The output register of the s2 and s3 pins when both are on the same 
+     * port, so the scheduler switches the filter with a single write, NULL
+     * otherwise (see Fast pin switching).
+     */
+    volatile unsigned char* filterPort;
+
+    /**
+     * The bit masks of the s2 and s3 pins in their output register.
+     */
+    unsigned char s2Mask;
+    unsigned char s3Mask;
+
+    /**
+     * The output register of the s0 and s1 pins when both are on the same
+     * port, NULL otherwise.
+     */
+    volatile unsigned char* scalingPort;
+
+    /**
+     * The bit masks of the s0 and s1 pins in their output register.
+     */
+    unsigned char s0Mask;
+    unsigned char s1Mask;
+
+    /**
+     * The external interrupt line of the out pin.
+     */
+    unsigned char interruptLine;
+
+    /**
+     * Whether the pulses are counted by the Timer5 hardware counter instead 
+     * of the external interrupt.
+     */
+    bool hardwareCounter;
+
+    /**
+     * Whether the gate was started by the previous sensor of the shared out
+     * line, during the current scheduler interrupt.
+     */
+    bool handedOver;
+
+    /**
+     * Whether the sensor is settling after a filter switch, so 
+     * remainingGateTime counts down to the start of the gate.
      */
-    int count;
+    bool settling;
+
+    /**
+     * Holds the number of interrupts of the current filter. It is 32 bits, as
+     * a 1s gate at 600KHz counts 600000 pulses. With the hardware counter it
+     * holds the pulses of the Timer5 overflows.
+     */
+    volatile unsigned long count;
+
+    /**
+     * Holds the last frequency, in Hz, for each filter. It is the frame being
+     * acquired, only touched by the scheduler.
+     * 
+     * NOTE: The frequencies are normalized to the 100% scaling, so they do not
+     * depend on the scaling they were measured with.
+     */
+    long lastFrequencies[4];
+
+    /**
+     * The last complete frame, published by the scheduler.
+     */
+    volatile ColorRecognitionFrame frame;
+
+    /**
+     * The version of the published frame. It is odd while the scheduler is
+     * writing the frame. Being a single byte, it is read and written 
+     * atomically, so readers detect a frame that changed under them without 
+     * disabling the interrupts.
+     */
+    volatile unsigned char frameVersion;
+
+    /**
+     * The ring buffer of complete frames. The scheduler is the only producer
+     * and drain() the only consumer.
+     */
+    volatile ColorRecognitionFrame frameBuffer[FRAME_BUFFER_SIZE];
+
+    /**
+     * The free running write index of the ring buffer, only written by the 
+     * scheduler.
+     */
+    volatile unsigned char frameBufferHead;
+
+    /**
+     * The free running read index of the ring buffer, only written by 
+     * drain().
+     */
+    volatile unsigned char frameBufferTail;
+
+    /**
+     * How many frames were dropped because the ring buffer was full.
+     */
+    volatile unsigned int frameBufferOverruns;
 
     /**
      * Holds the last count for each filter.
      */
-    int lastFrequencies[3];
+    unsigned long lastCounts[4];
+
+    /**
+     * Holds the gate time, in milliseconds, of each filter.
+     */
+    unsigned int gateTimes[4];
+
+    /**
+     * Holds the gate time, in milliseconds, of the gate being counted.
+     */
+    unsigned int currentGateTime;
+
+    /**
+     * How long, in milliseconds, until the gate being counted ends.
+     */
+    unsigned int remainingGateTime;
+
+    /**
+     * How long, in milliseconds, the sensor settles after a filter switch,
+     * 0 to count at once.
+     */
+    unsigned int settleTime;
+
+    /**
+     * Whether the gate time adapts itself to the counts.
+     */
+    bool adaptiveGate;
+
+    /**
+     * The number of counts the adaptive gate aims for.
+     */
+    unsigned int targetCount;
+
+    /**
+     * The adaptive gate limits, in milliseconds.
+     */
+    unsigned int minGateTime;
+    unsigned int maxGateTime;
 
     /**
-     * Holds the maximum frequencies.
+     * Holds the white balance, as the scale factors of each filter.
      */
-    int whiteBalanceFrequencies[3];
+    ColorRecognitionScale whiteBalance;
 
     /**
-     * Singleton. The instance.
+     * The default instance.
      */
     static ColorRecognitionTCS230 instance;
 
+    /**
+     * The instances served by the scheduler.
+     */
+    static ColorRecognitionTCS230* instances[MAX_INSTANCES];
+
+    /**
+     * The number of instances served by the scheduler.
+     */
+    static unsigned char instanceCount;
+
+    /**
+     * The dispatch table, mapping each external interrupt line to the
+     * instance whose out pin is wired to it. On a shared out line, it is the
+     * instance being counted.
+     */
+    static ColorRecognitionTCS230* interruptTable[EXTERNAL_INTERRUPTS];
+
+    /**
+     * The instance counting with Timer5, NULL for none.
+     */
+    static ColorRecognitionTCS230* hardwareCounterInstance;
+
+    /**
+     * The current Timer1 period, in milliseconds.
+     */
+    static unsigned int schedulerPeriod;
+
 public:
 
     /**
@@ -143,42 +486,528 @@ public:
         CLEAR_FILTER
     };
 
+    /**
+     * Output frequency scaling enumeration.
+     */
+    enum Scaling {
+        POWER_DOWN,
+        SCALING_2,
+        SCALING_20,
+        SCALING_100
+    };
+
+    /**
+     * Acquisition schedule enumeration.
+     */
+    enum Schedule {
+        RGB_SCHEDULE,
+        RGBC_SCHEDULE
+    };
+
     /**
      * Current filter.
      */
     Filter currentFilter;
 
+private:
+
+    /**
+     * The filters acquired in each frame.
+     */
+    Schedule schedule;
+
+    /**
+     * The scaling of each filter.
+     */
+    Scaling scalings[4];
+
+    /**
+     * The scaling of the gate being counted.
+     */
+    Scaling currentScaling;
+
+    /**
+     * Whether the scaling of each filter is picked by the auto ranging.
+     */
+    bool autoRange;
+
+    /**
+     * The filter chain run on each frame, by the scheduler.
+     */
+    ColorRecognitionFrameFilter* volatile frameFilter;
+
+    /**
+     * The change detector run on each frame, by the scheduler.
+     */
+    ColorRecognitionChangeDetector* volatile changeDetector;
+
     /**
-     * Singleton. Gets the instance of the driver.
+     * Whether the white balance is averaging frames.
+     */
+    bool balancing;
+
+    /**
+     * The maximum and the current number of frames averaged by the white 
+     * balance.
+     */
+    unsigned char balanceFrames;
+    unsigned char balanceCount;
+
+    /**
+     * The white balance progress, from 0 to 100.
+     */
+    unsigned char balanceProgress;
+
+    /**
+     * The sequence of the last frame the white balance took, or skipped.
+     */
+    unsigned long balanceSequence;
+
+    /**
+     * The sums and the averages of the frames taken by the white balance.
+     */
+    long balanceSums[4];
+    long balanceAverages[4];
+
+    /**
+     * The white balance progress callback, NULL for none.
+     */
+    WhiteBalanceCallback balanceCallback;
+
+#if COLOR_RECOGNITION_STATISTICS
+    /**
+     * The acquisition statistics, updated by the scheduler.
+     */
+    ColorRecognitionStatistics driverStatistics;
+
+    /**
+     * When the gate being counted started, in microseconds.
+     */
+    unsigned long gateStart;
+#endif
+
+public:
+
+    /**
+     * Public constructor. Each instance drives one sensor.
+     */
+    ColorRecognitionTCS230()
+            : s2Pin(0), s3Pin(0), s0Pin(NOT_WIRED), s1Pin(NOT_WIRED), outPin(0), oePin(NOT_WIRED), filterPort(0), s2Mask(0),
+              s3Mask(0), scalingPort(0), s0Mask(0), s1Mask(0), interruptLine(0), hardwareCounter(false), handedOver(false), settling(false),
+              count(0), frameVersion(0),
+              frameBufferHead(0), frameBufferTail(0), frameBufferOverruns(0),
+              currentGateTime(DEFAULT_GATE_TIME_IN_MS),
+              remainingGateTime(DEFAULT_GATE_TIME_IN_MS), settleTime(DEFAULT_SETTLE_TIME_IN_MS), adaptiveGate(false), targetCount(DEFAULT_TARGET_COUNT),
+              minGateTime(MIN_GATE_TIME_IN_MS), maxGateTime(MAX_GATE_TIME_IN_MS),
+              whiteBalance(MAX_FRQUENCY_IN_HZ * 50L), currentFilter(RED_FILTER),
+              schedule(RGB_SCHEDULE), currentScaling(SCALING_2), autoRange(false),
+              frameFilter(0), changeDetector(0), balancing(false), balanceFrames(0), balanceCount(0), balanceProgress(0),
+              balanceSequence(0), balanceCallback(0) {
+        for (unsigned char i = 0; i < 4; i++) {
+            lastFrequencies[i] = 0;
+            lastCounts[i] = 0;
+            gateTimes[i] = DEFAULT_GATE_TIME_IN_MS;
+            scalings[i] = SCALING_2;
+            frame.frequencies[i] = 0;
+            balanceSums[i] = 0;
+            balanceAverages[i] = 0;
+        }
+        frame.sequence = 0;
+        frame.timestamp = 0;
+#if COLOR_RECOGNITION_STATISTICS
+        gateStart = 0;
+        clearDriverStatistics();
+#endif
+    }
+
+    /**
+     * Gets the default instance of the driver, for sketches with a single
+     * sensor.
      * 
-     * @return 
+     * @return
      */
     static ColorRecognitionTCS230* getInstance() {
         return &ColorRecognitionTCS230::instance;
     }
 
-    virtual ~ColorRecognitionTCS230() {
-    }
+    /**
+     * Unregisters the instance from the shared scheduler.
+     */
+    virtual ~ColorRecognitionTCS230();
+
+    /**
+     * Initializes the IO and registers the instance in the shared Timer1
+     * scheduler.
+     * 
+     * All the instances are counted in parallel on the same Timer1, so
+     * initializing an instance restarts the schedule of all of them, which
+     * keeps instances with the same gate times switching filters together.
+     * Each restarted instance begins a new frame with its red gate.
+     * 
+     * @param outPin                The out pin. (NOTE: It must be an external
+     *                              interrupt pin, and each instance needs
+     *                              its own).
+     * @param s2Pin                 The s2 pin.
+     * @param s3Pin                 The s3 pin.
+     * 
+     * @return                      If the instance could be registered,
+     *                              false when another instance already 
+     *                              counts on the out pin.
+     */
+    bool initialize(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin);
+
+    /**
+     * Initializes the IO, including the scaling pins, and registers the 
+     * instance in the shared Timer1 scheduler.
+     * 
+     * @param outPin                The out pin. (NOTE: It must be an external
+     *                              interrupt pin, and each instance needs 
+     *                              its own).
+     * @param s2Pin                 The s2 pin.
+     * @param s3Pin                 The s3 pin.
+     * @param s0Pin                 The s0 pin.
+     * @param s1Pin                 The s1 pin.
+     * 
+     * @return                      If the instance could be registered.
+     */
+    bool initialize(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin, unsigned char s0Pin,
+            unsigned char s1Pin);
+
+    /**
+     * Initializes the IO, counting the pulses with the Timer5 hardware 
+     * counter, and registers the instance in the shared Timer1 scheduler.
+     * 
+     * Only one instance can use the hardware counter, and it cannot be mixed
+     * with initialize() on the same instance.
+     * 
+     * @param s2Pin                 The s2 pin.
+     * @param s3Pin                 The s3 pin.
+     * @param s0Pin                 The s0 pin.
+     * @param s1Pin                 The s1 pin.
+     * 
+     * @return                      If the instance could be registered, false 
+     *                              on boards without Timer5.
+     */
+    bool initializeHardwareCounter(unsigned char s2Pin, unsigned char s3Pin, unsigned char s0Pin = NOT_WIRED,
+            unsigned char s1Pin = NOT_WIRED);
+
+    /**
+     * Timer5 overflow interrupt handler. It adds the 65536 pulses of the wrap
+     * to the count of the hardware counter instance.
+     */
+    static void counterOverflowHandler();
 
     /**
-     * Initializes the IO and timers.
+     * Initializes the IO of a sensor whose out pin is wired together with 
+     * the out pins of other sensors, and registers the instance in the 
+     * shared Timer1 scheduler.
+     * 
+     * The sensors of the same out pin take turns, one gate each (see Shared
+     * out line), so each frame takes the gates of all of them.
      * 
-     * @param outPin                The out pin. (NOTE: It must be the 2 or 3 
-     *                              pin to support external interrupts).
+     * @param outPin                The out pin, shared. (NOTE: It must be an
+     *                              external interrupt pin, not used by 
+     *                              initialize()).
+     * @param oePin                 The OE pin, of this sensor only.
      * @param s2Pin                 The s2 pin.
      * @param s3Pin                 The s3 pin.
+     * @param s0Pin                 The s0 pin.
+     * @param s1Pin                 The s1 pin.
+     * 
+     * @return                      If the instance could be registered.
+     */
+    bool initializeShared(unsigned char outPin, unsigned char oePin, unsigned char s2Pin, unsigned char s3Pin,
+            unsigned char s0Pin = NOT_WIRED, unsigned char s1Pin = NOT_WIRED);
+
+    /**
+     * Sets the same output frequency scaling for all filters, and disables 
+     * the auto ranging.
+     * 
+     * It has no effect when the s0 and s1 pins are not wired.
+     * 
+     * @param scaling       The scaling.
+     */
+    void setScaling(Scaling scaling);
+
+    /**
+     * Returns the output frequency scaling of one filter.
+     * 
+     * @param filter        The filter.
+     * @return              The scaling.
+     */
+    Scaling getScaling(Filter filter);
+
+    /**
+     * Enables the auto ranging.
      * 
-     * @return 
+     * After each gate, the scaling of the filter is moved to the highest one 
+     * that keeps the out pin under AUTO_RANGE_MAX_FREQUENCY. It keeps the 
+     * interrupt load bounded in bright light and the counts high in low 
+     * light. It has no effect when the s0 and s1 pins are not wired.
      */
-    void initialize(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin);
+    void enableAutoRange();
+
+    /**
+     * Disables the auto ranging, keeping the current scalings.
+     */
+    void disableAutoRange();
+
+    /**
+     * Sets the filter chain run on each frame, between the acquisition and 
+     * the conversion to intensities. The history of the chain is reset.
+     * 
+     * @param filter        The first filter of the chain, NULL for none.
+     */
+    void setFrameFilter(ColorRecognitionFrameFilter* filter);
+
+    /**
+     * Sets the change detector run on each frame, after the filter chain.
+     * It runs inside the scheduler interrupt, so the sketch only checks
+     * hasChanged() or gets the callback, instead of polling the intensities.
+     * The baseline of the detector is reset.
+     * 
+     * @param detector      The detector, NULL for none.
+     */
+    void setChangeDetector(ColorRecognitionChangeDetector* detector);
 
     /**
      * Store the current read as the maximum frequency for each color.
      * 
-     * It tells what is considered white.
+     * It tells what is considered white. It runs startWhiteBalance() and
+     * blocks until it is done, so it takes from 2 to 9 frame periods. It 
+     * returns at once if the instance is not initialized.
      */
     void adjustWhiteBalance();
 
+    /**
+     * Starts adjusting the white balance in the background.
+     * 
+     * The frame being acquired is skipped, as it started before the call,
+     * and the next frames are averaged until the average is stable or the
+     * given number of frames is reached. Then the average becomes the white
+     * balance. The frames are taken by updateWhiteBalance(), which must be
+     * called from the loop at least once per frame period, or frames are 
+     * skipped.
+     * 
+     * @param frames        The maximum number of frames to average.
+     * @param callback      The progress callback, NULL for none.
+     */
+    void startWhiteBalance(unsigned char frames = WHITE_BALANCE_FRAMES, WhiteBalanceCallback callback = 0);
+
+    /**
+     * Takes the frames completed since the last call into the white balance
+     * started by startWhiteBalance(). It never blocks.
+     * 
+     * @return              If the white balance is done (or not started).
+     */
+    bool updateWhiteBalance();
+
+    /**
+     * Returns if the white balance is averaging frames.
+     * 
+     * @return              If startWhiteBalance() is not done yet.
+     */
+    bool isBalancing();
+
+    /**
+     * Returns the white balance progress.
+     * 
+     * @return              The progress, from 0 to 100 (done).
+     */
+    unsigned char getWhiteBalanceProgress();
+
+    /**
+     * Saves the white balance, the scalings, the gate times, the schedule 
+     * and the auto ranging and adaptive gate flags to the EEPROM.
+     * 
+     * @param address       The EEPROM address of the record, which takes
+     *                      ColorRecognitionCalibration::getSize() bytes.
+     */
+    void saveCalibration(int address = 0);
+
+    /**
+     * Loads what saveCalibration() saved, so the sketch can skip 
+     * adjustWhiteBalance() and its 2 to 9 frames of wait at start up. It must be
+     * called after initialize(), as the scalings need the s0 and s1 pins.
+     * 
+     * The adaptive gate is restored with its default target and limits.
+     * 
+     * @param address       The EEPROM address of the record.
+     * @return              If a valid record was loaded. When not, nothing
+     *                      changes and the sensor must be calibrated.
+     */
+    bool loadCalibration(int address = 0);
+
+    /**
+     * Sets the filters acquired in each frame, from the next frame on.
+     * 
+     * RGB_SCHEDULE (the default) counts the red, green and blue filters, and
+     * the clear frequency of the frames is 0. RGBC_SCHEDULE adds the clear 
+     * gate, so the frames carry the clear frequency and the chromaticity can
+     * be computed, but with the same gate times a frame takes 4/3 of the 
+     * time.
+     * 
+     * @param schedule      The schedule.
+     */
+    void setSchedule(Schedule schedule);
+
+    /**
+     * Returns the filters acquired in each frame.
+     * 
+     * @return              The schedule.
+     */
+    Schedule getSchedule();
+
+    /**
+     * Sets the same gate time for all filters.
+     * 
+     * @param gateTime      The gate time, in milliseconds.
+     */
+    void setGateTime(unsigned int gateTime);
+
+    /**
+     * Sets the gate time of one filter.
+     * 
+     * The gate time is how long the pulses of each filter are counted. Longer
+     * gates give more counts, so better resolution, at a lower frame rate.
+     * 
+     * @param filter        The filter.
+     * @param gateTime      The gate time, in milliseconds.
+     */
+    void setGateTime(Filter filter, unsigned int gateTime);
+
+    /**
+     * Returns the gate time of one filter.
+     * 
+     * @param filter        The filter.
+     * @return              The gate time, in milliseconds.
+     */
+    unsigned int getGateTime(Filter filter);
+
+    /**
+     * Sets how long the sensor settles after each filter switch, before the
+     * gate starts. The pulses of the settle time are discarded (see Filter 
+     * settling).
+     * 
+     * @param settleTime    The settle time, in milliseconds, 0 to count at 
+     *                      once.
+     */
+    void setSettleTime(unsigned int settleTime);
+
+    /**
+     * Returns how long the sensor settles after each filter switch.
+     * 
+     * @return              The settle time, in milliseconds.
+     */
+    unsigned int getSettleTime();
+
+    /**
+     * Enables the adaptive gate.
+     * 
+     * After each gate, the gate time of the filter is recalculated to be the
+     * shortest one that collects the target count at the last measured
+     * frequency. So bright channels are measured quickly and dark channels
+     * are measured longer.
+     * 
+     * @param targetCount   The number of counts each gate aims for.
+     * @param minGateTime   The shortest gate time, in milliseconds.
+     * @param maxGateTime   The longest gate time, in milliseconds.
+     */
+    void enableAdaptiveGate(unsigned int targetCount = DEFAULT_TARGET_COUNT,
+            unsigned int minGateTime = MIN_GATE_TIME_IN_MS, unsigned int maxGateTime = MAX_GATE_TIME_IN_MS);
+
+    /**
+     * Disables the adaptive gate, keeping the current gate times.
+     */
+    void disableAdaptiveGate();
+
+    /**
+     * Returns the time one full frame takes, with the current schedule and
+     * settle time.
+     * 
+     * On a shared out line it adds the frame periods of all the sensors of
+     * the line, which is exact when they use the same schedule.
+     * 
+     * @return              The frame period, in milliseconds.
+     */
+    unsigned long getFramePeriod();
+
+    /**
+     * Returns how many frames are acquired per second.
+     * 
+     * @return              The frame rate, in Hz.
+     */
+    float getFrameRate();
+
+    /**
+     * Returns the effective resolution of the last gate of one filter.
+     * 
+     * It is the number of counts collected, so the frequency of the filter is
+     * resolved to one part in the returned value.
+     * 
+     * @param filter        The filter.
+     * @return              The number of counts of the last gate.
+     */
+    unsigned long getResolution(Filter filter);
+
+    /**
+     * Reads the last complete frame.
+     * 
+     * The red, green, blue and clear frequencies of the returned frame were
+     * all acquired in the same cycle. The sequence number tells if frames were 
+     * dropped or read twice since the last call.
+     * 
+     * @param frame         The frame to fill.
+     * @return              If a frame was acquired yet.
+     */
+    bool readFrame(ColorRecognitionFrame* frame);
+
+    /**
+     * Moves the buffered frames, oldest first, to the given array.
+     * 
+     * Every frame completed since the last drain is kept in a ring buffer of 
+     * FRAME_BUFFER_SIZE frames, so a reader that drains at least once every 
+     * FRAME_BUFFER_SIZE frame periods loses nothing. When the buffer is full,
+     * the new frames are dropped and counted as overruns.
+     * 
+     * @param frames        The array to fill.
+     * @param n             The array capacity.
+     * @return              How many frames were moved.
+     */
+    unsigned char drain(ColorRecognitionFrame* frames, unsigned char n);
+
+    /**
+     * Returns how many frames are waiting in the ring buffer.
+     * 
+     * @return              The number of buffered frames.
+     */
+    unsigned char available();
+
+    /**
+     * Returns how many frames were dropped because the ring buffer was full.
+     * 
+     * @return              The number of dropped frames.
+     */
+    unsigned int getOverruns();
+
+#if COLOR_RECOGNITION_STATISTICS
+    /**
+     * Copies the acquisition statistics, all taken at the same time.
+     * 
+     * Only compiled when COLOR_RECOGNITION_STATISTICS is 1. The edges and
+     * the overflows are counted at the end of each gate, so the statistics
+     * add no work to the out pin interrupt.
+     * 
+     * @param statistics    The statistics to fill.
+     */
+    void getStatistics(ColorRecognitionStatistics* statistics);
+
+    /**
+     * Clears the acquisition statistics.
+     */
+    void resetStatistics();
+#endif
+
     /**
      * Returns the red color intensity.
      * 
@@ -207,6 +1036,43 @@ public:
      */
     bool fillRGB(unsigned char buf[3]);
 
+    /**
+     * Fills the 16 bits red, green and blue intensities of the last complete
+     * frame, according to the white balance.
+     * 
+     * @param buf           The buffer to fill.
+     * @return              If a frame was acquired yet.
+     */
+    bool fillRGB16(unsigned int buf[3]);
+
+    /**
+     * Fills the red, green and blue frequencies of the last complete frame.
+     * 
+     * @param buf           The buffer to fill.
+     * @return              If a frame was acquired yet.
+     */
+    bool fillFrequencies(long buf[3]);
+
+    /**
+     * Returns the clear (no filter) intensity, according to the white 
+     * balance. It needs the RGBC_SCHEDULE, otherwise it is 0.
+     * 
+     * @return              The clear intensity.
+     */
+    unsigned char getClear();
+
+    /**
+     * Fills the chromaticity of the last complete frame: the red, green and 
+     * blue frequencies divided by the clear one, from 0 (0.0) to 255 (1.0).
+     * 
+     * The ratios do not change with the brightness of the light, so they tell
+     * the color without a white balance. It needs the RGBC_SCHEDULE.
+     * 
+     * @param buf           The buffer to fill.
+     * @return              If a frame with the clear frequency was acquired.
+     */
+    bool fillChromaticity(unsigned char buf[3]);
+
     /**
      * Sets the s2 and s3 pins according of the color passed as filter.
      * 
@@ -220,27 +1086,218 @@ public:
      * 
      * @param filter        The next filter.
      */
-    static void setFilter(Filter filter);
+    void setFilter(Filter filter);
+
+    /**
+     * Returns the percentage of the full scale output frequency of a scaling.
+     * 
+     * @param scaling       The scaling.
+     * @return              The percentage.
+     */
+    static unsigned char getScalingPercentage(Scaling scaling);
 
 private:
 
+#if COLOR_RECOGNITION_STATISTICS
     /**
-     * Private constructor.
+     * Clears the acquisition statistics, without disabling the interrupts.
      */
-    ColorRecognitionTCS230()
-            : s2Pin(0), s3Pin(0), outPin(0), count(0), currentFilter(CLEAR_FILTER) {
-        whiteBalanceFrequencies[0] = MAX_FRQUENCY_IN_HZ;
-        whiteBalanceFrequencies[1] = MAX_FRQUENCY_IN_HZ;
-        whiteBalanceFrequencies[2] = MAX_FRQUENCY_IN_HZ;
-    }
+    void clearDriverStatistics();
+#endif
+
+    /**
+     * Sets the s0 and s1 pins according to the scaling, when they are wired.
+     * 
+     * <pre>
+     * S0   S1  OUTPUT FREQUENCY
+     * L    L   Power down
+     * L    H   2%
+     * H    L   20%
+     * H    H   100%
+     * </pre>
+     * 
+     * @param scaling       The scaling.
+     */
+    void applyScaling(Scaling scaling);
+
+    /**
+     * Moves the scaling of a filter according to the frequency measured at 
+     * its current scaling.
+     * 
+     * @param filter        The filter.
+     * @param frequency     The out pin frequency, in Hz.
+     */
+    void adjustRange(Filter filter, long frequency);
+
+    /**
+     * Sets the pins up and registers the instance in the shared Timer1 
+     * scheduler.
+     * 
+     * @return              If the instance could be registered.
+     */
+    bool registerInstance(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin, unsigned char s0Pin,
+            unsigned char s1Pin);
+
+    /**
+     * Resolves the output registers and bit masks of the filter and scaling
+     * pins.
+     */
+    void resolvePins();
+
+    /**
+     * Returns the output register of two pins, if they are on the same port.
+     * 
+     * @param pin1          The first pin.
+     * @param pin2          The second pin.
+     * @param mask1         Filled with the bit mask of the first pin.
+     * @param mask2         Filled with the bit mask of the second pin.
+     * @return              The output register, NULL if the pins are on 
+     *                      different ports.
+     */
+    static volatile unsigned char* resolvePort(unsigned char pin1, unsigned char pin2, unsigned char* mask1,
+            unsigned char* mask2);
+
+    /**
+     * Attaches the handler of an external interrupt line of the dispatch 
+     * table.
+     * 
+     * @param line          The external interrupt line.
+     */
+    static void attachInterruptLine(unsigned char line);
+
+    /**
+     * Returns the pulses counted in the current gate.
+     * 
+     * @return              The count.
+     */
+    unsigned long readCount();
+
+    /**
+     * Clears the pulses counted in the current gate.
+     */
+    void clearCount();
+
+    /**
+     * Converts a count of the current gate to a frequency, without 
+     * overflowing 32 bits for any count of the longest gate.
+     * 
+     * @param count         The count.
+     * @param multiplier    1000 times the scaling factor to normalize with.
+     * @return              The frequency, in Hz.
+     */
+    long toFrequency(unsigned long count, unsigned long multiplier);
+
+    /**
+     * Stores the count of the gate that just ended for the given filter and,
+     * when the adaptive gate is enabled, recalculates its next gate time.
+     * 
+     * @param filter        The filter whose gate ended.
+     * @param count         The count of the gate.
+     * @param scaling       The scaling the gate was counted with.
+     */
+    void endGate(Filter filter, unsigned long count, Scaling scaling);
+
+    /**
+     * Ends the gate being counted, switches to the next filter and starts
+     * its gate, or the gate of the next sensor of a shared out line. The 
+     * gate is computed after the switch, while the filter settles.
+     */
+    void nextGate();
+
+    /**
+     * Starts the settle time of the current filter, or its gate when there
+     * is no settle time.
+     */
+    void settleGate();
+
+    /**
+     * Starts counting the gate of the current filter.
+     * 
+     * @param clear         Whether the count is cleared, false when it was
+     *                      cleared as the last gate was read.
+     */
+    void startGate(bool clear = true);
+
+    /**
+     * Returns if the instance waits for its turn on a shared out line.
+     * 
+     * @return              If another sensor of the line is being counted.
+     */
+    bool isIdle();
+
+    /**
+     * Returns the sensor after this one on its shared out line.
+     * 
+     * @return              The next sensor, this one when it is alone.
+     */
+    ColorRecognitionTCS230* nextShared();
+
+    /**
+     * Disables this sensor and starts the gate of the next one on the shared
+     * out line. Must be called with the interrupts disabled.
+     * 
+     * @param next          The next sensor of the line.
+     */
+    void handOver(ColorRecognitionTCS230* next);
+
+    /**
+     * Returns the time the gates of one frame of this sensor take.
+     * 
+     * @return              The time, in milliseconds.
+     */
+    unsigned long getGatesTime();
+
+    /**
+     * Returns the time this sensor settles in one frame.
+     * 
+     * @return              The time, in milliseconds.
+     */
+    unsigned long getSettlesTime();
+
+    /**
+     * Publishes the frame that was just completed.
+     */
+    void publishFrame();
+
+    /**
+     * Copies a frame shared with the scheduler.
+     * 
+     * @param to            The frame to fill.
+     * @param from          The shared frame.
+     */
+    static void copyFrame(volatile ColorRecognitionFrame* to, volatile ColorRecognitionFrame* from);
+
+    /**
+     * Converts a frequency to color intensity, according to the white 
+     * balance of the filter.
+     * 
+     * @param filter        The filter.
+     * @param frequency     The frequency, in Hz.
+     * @return              The color intensity.
+     */
+    unsigned char getIntensity(Filter filter, long frequency);
+
+    /**
+     * Restarts the schedule of all instances. Must be called with the
+     * interrupts disabled.
+     */
+    static void restartScheduler();
 
     /**
-     * Device output interruption handler.
+     * Device output interruption handlers, one for each external interrupt
+     * line of the dispatch table.
      */
-    static void externalInterruptHandler();
+    static void externalInterruptHandler0();
+    static void externalInterruptHandler1();
+    static void externalInterruptHandler2();
+    static void externalInterruptHandler3();
+    static void externalInterruptHandler4();
+    static void externalInterruptHandler5();
 
     /**
-     * TimerOne interrupt handler.
+     * TimerOne interrupt handler. It is the shared scheduler: it ends the
+     * gates of all the instances whose gates elapsed and programs Timer1 to
+     * the nearest gate end.
      */
     static void timerInterruptHandler();
 };
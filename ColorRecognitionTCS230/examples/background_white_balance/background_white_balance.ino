@@ -0,0 +1,39 @@
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+
+// The white balance runs in the background: the loop keeps blinking the LED
+// while the frames are averaged, and the progress is printed as it goes.
+ColorRecognitionTCS230 tcs230;
+
+void printProgress(unsigned char progress) {
+  Serial.print("White balance: ");
+  Serial.print(progress);
+  Serial.println("%");
+}
+
+void setup() {
+  Serial.begin(9600);
+  pinMode(LED_BUILTIN, OUTPUT);
+  
+  tcs230.initialize(2, 3, 4);
+  tcs230.setGateTime(100);
+  
+  Serial.println("Adjusting the white balance... show something white to the sensor.");
+  tcs230.startWhiteBalance(8, printProgress);
+}
+
+void loop() {
+  if (!tcs230.updateWhiteBalance()) {
+    digitalWrite(LED_BUILTIN, (millis() / 100) & 1);
+    return;
+  }
+  digitalWrite(LED_BUILTIN, LOW);
+  Serial.print("Red: ");
+  Serial.print(tcs230.getRed());
+  Serial.print(" Green: ");
+  Serial.print(tcs230.getGreen());
+  Serial.print(" Blue: ");
+  Serial.println(tcs230.getBlue());
+  delay(300);
+}
@@ -0,0 +1,33 @@
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+#include <ColorRecognitionStream.h>
+
+// Streams every frame as a 30 bytes binary packet. Decode them on the PC
+// with the stream-dump tool of the host build (make decoder):
+//
+//   stty -F /dev/ttyUSB0 115200 raw && build/host/stream-dump < /dev/ttyUSB0
+ColorRecognitionTCS230 tcs230;
+ColorRecognitionStream stream(&Serial);
+ColorRecognitionFrame frames[FRAME_BUFFER_SIZE];
+unsigned int overruns = 0;
+
+void setup() {
+  Serial.begin(115200);
+  
+  tcs230.setGateTime(10);
+  tcs230.initialize(2, 3, 4);
+}
+
+void loop() {
+  unsigned char n = tcs230.drain(frames, FRAME_BUFFER_SIZE);
+  unsigned char flags = 0;
+  if (n == 0) {
+    return;
+  }
+  if (tcs230.getOverruns() != overruns) {
+    overruns = tcs230.getOverruns();
+    flags |= STREAM_FLAG_OVERRUN;
+  }
+  stream.writeFrames(frames, n, flags);
+}
@@ -0,0 +1,43 @@
+#include <avr/sleep.h>
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+
+// The sketch sleeps until the color in front of the sensor changes by more
+// than 12.5% for 2 frames in a row, for example when an object arrives or
+// leaves. The scheduler interrupt wakes the processor on every gate, and
+// the detector runs inside it.
+ColorRecognitionTCS230 tcs230;
+ColorRecognitionChangeDetector detector(32, 2);
+
+void onChange(const long* frequencies) {
+  // Called inside the interrupt: keep it short.
+  digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+}
+
+void setup() {
+  Serial.begin(9600);
+  pinMode(LED_BUILTIN, OUTPUT);
+  
+  tcs230.initialize(2, 3, 4);
+  tcs230.setGateTime(20);
+  tcs230.adjustWhiteBalance();
+  
+  detector.setCallback(onChange);
+  tcs230.setChangeDetector(&detector);
+}
+
+void loop() {
+  if (detector.hasChanged()) {
+    Serial.print("Changed to red: ");
+    Serial.print(tcs230.getRed());
+    Serial.print(" green: ");
+    Serial.print(tcs230.getGreen());
+    Serial.print(" blue: ");
+    Serial.println(tcs230.getBlue());
+    Serial.flush();
+  }
+  // The idle mode keeps the timers running, so the next gate wakes it up.
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_mode();
+}
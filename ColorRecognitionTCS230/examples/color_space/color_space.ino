@@ -0,0 +1,44 @@
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+#include <ColorRecognitionColorSpace.h>
+
+// Prints the hue of the color, in degrees, and how far it is, in delta E, 
+// from the color seen at start up.
+ColorRecognitionTCS230* tcs230 = ColorRecognitionTCS230::getInstance();
+ColorRecognitionLab reference;
+
+void setup() {
+  unsigned char rgb[3];
+  Serial.begin(9600);
+  
+  tcs230->initialize(2, 4, 5);
+  tcs230->setGateTime(100);
+  
+  Serial.print("Adjusting the white balance... show something white to the sensor.");
+  
+  // Show something white to it until it returns, from 2 to 9 frames.
+  tcs230->adjustWhiteBalance();
+  tcs230->fillRGB(rgb);
+  ColorRecognitionColorSpace::toLab(rgb, &reference);
+}
+
+void loop() {
+  unsigned char rgb[3];
+  ColorRecognitionHsv hsv;
+  ColorRecognitionLab lab;
+  tcs230->fillRGB(rgb);
+  ColorRecognitionColorSpace::toHsv(rgb, &hsv);
+  ColorRecognitionColorSpace::toLab(rgb, &lab);
+  Serial.print("Hue: ");
+  Serial.print(hsv.hue * 360L / COLOR_SPACE_HUE_STEPS);
+  Serial.print(" L: ");
+  Serial.print(lab.lightness);
+  Serial.print(" a: ");
+  Serial.print(lab.a);
+  Serial.print(" b: ");
+  Serial.print(lab.b);
+  Serial.print(" dE: ");
+  Serial.println(sqrt(ColorRecognitionColorSpace::getDistance(&lab, &reference)));
+  delay(300);
+}
@@ -0,0 +1,34 @@
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+
+// Arduino Mega only: the out pin is wired to T5 (digital pin 47) and counted
+// by Timer5, so the sensor can run at the 100% scaling (S0 on 8, S1 on 9)
+// with one interrupt per gate.
+ColorRecognitionTCS230 tcs230;
+
+void setup() {
+  Serial.begin(9600);
+  
+  if (!tcs230.initializeHardwareCounter(4, 5, 8, 9)) {
+    Serial.println("No Timer5 on this board.");
+    while (true);
+  }
+  tcs230.setScaling(ColorRecognitionTCS230::SCALING_100);
+  tcs230.setGateTime(20);
+  
+  Serial.print("Adjusting the white balance... show something white to the sensor.");
+  
+  // Show something white to it until it returns, from 2 to 9 frames.
+  tcs230.adjustWhiteBalance();
+}
+
+void loop() {
+  Serial.print("Red: ");
+  Serial.print(tcs230.getRed());
+  Serial.print(" Green: ");
+  Serial.print(tcs230.getGreen());
+  Serial.print(" Blue: ");
+  Serial.println(tcs230.getBlue());
+  delay(300);
+}
@@ -0,0 +1,39 @@
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+
+// Both sensors are counted in parallel on the same Timer1 gate. Each out 
+// pin must be an external interrupt pin.
+ColorRecognitionTCS230 left;
+ColorRecognitionTCS230 right;
+
+void printColor(const char* name, ColorRecognitionTCS230& tcs230) {
+  Serial.print(name);
+  Serial.print(" Red: ");
+  Serial.print(tcs230.getRed());
+  Serial.print(" Green: ");
+  Serial.print(tcs230.getGreen());
+  Serial.print(" Blue: ");
+  Serial.println(tcs230.getBlue());
+}
+
+void setup() {
+  Serial.begin(9600);
+  
+  left.initialize(2, 4, 5);
+  right.initialize(3, 6, 7);
+  left.setGateTime(100);
+  right.setGateTime(100);
+  
+  Serial.print("Adjusting the white balance... show something white to the sensors.");
+  
+  // Show something white to them until they return, from 2 to 9 frames each.
+  left.adjustWhiteBalance();
+  right.adjustWhiteBalance();
+}
+
+void loop() {
+  printColor("Left", left);
+  printColor("Right", right);
+  delay(300);
+}
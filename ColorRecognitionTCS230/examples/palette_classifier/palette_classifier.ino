@@ -0,0 +1,54 @@
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+#include <ColorRecognitionClassifier.h>
+
+// Classifies the color under the sensor into a palette of known colors. The
+// 3 bits table (8x8x8 entries) takes 256 bytes of RAM, for a 16x16x16 table
+// on a board with 2KB of RAM, print the table built on a bigger board and 
+// pass it in PROGMEM to setTable().
+ColorRecognitionTCS230* tcs230 = ColorRecognitionTCS230::getInstance();
+ColorRecognitionClassifier classifier(3);
+unsigned char table[CLASSIFIER_TABLE_SIZE(3)];
+
+const char* names[] = {"Red", "Green", "Blue", "Yellow", "White", "Black"};
+
+void setup() {
+  Serial.begin(9600);
+  
+  tcs230->initialize(2, 3, 4);
+  tcs230->setGateTime(100);
+  
+  Serial.println("Adjusting the white balance... show something white to the sensor.");
+  
+  // Show something white to it until it returns, from 2 to 9 frames.
+  tcs230->adjustWhiteBalance();
+  
+  classifier.addColor(255, 0, 0);
+  classifier.addColor(0, 255, 0);
+  classifier.addColor(0, 0, 255);
+  classifier.addColor(255, 255, 0);
+  classifier.addColor(255, 255, 255);
+  classifier.addColor(0, 0, 0);
+  classifier.build(table);
+  
+  Serial.print("Table built in ");
+  Serial.print(classifier.getBuildTime());
+  Serial.print("us, using ");
+  Serial.print(classifier.getFootprint());
+  Serial.println(" bytes.");
+}
+
+void loop() {
+  unsigned char confidence;
+  unsigned char color = classifier.classify(tcs230, &confidence);
+  if (color == CLASSIFIER_UNKNOWN) {
+    Serial.println("Unknown");
+  } else {
+    Serial.print(names[color]);
+    Serial.print(" (");
+    Serial.print(confidence);
+    Serial.println(")");
+  }
+  delay(300);
+}
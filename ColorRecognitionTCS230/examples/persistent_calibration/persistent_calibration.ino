@@ -0,0 +1,38 @@
+#include <EEPROM.h>
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+
+// The white balance is adjusted once and kept in the EEPROM, so after a reset
+// the sensor is ready in a few milliseconds. Hold the pin 7 LOW during the
+// reset to calibrate again.
+#define RECALIBRATE_PIN 7
+
+ColorRecognitionTCS230 tcs230;
+
+void setup() {
+  Serial.begin(9600);
+  pinMode(RECALIBRATE_PIN, INPUT_PULLUP);
+  
+  tcs230.initialize(2, 3, 4);
+  
+  if (digitalRead(RECALIBRATE_PIN) == LOW || !tcs230.loadCalibration()) {
+    Serial.println("Adjusting the white balance... show something white to the sensor.");
+    
+    // Show something white to it until it returns, from 2 to 9 frames.
+    tcs230.adjustWhiteBalance();
+    tcs230.saveCalibration();
+  } else {
+    Serial.println("Calibration loaded.");
+  }
+}
+
+void loop() {
+  Serial.print("Red: ");
+  Serial.print(tcs230.getRed());
+  Serial.print(" Green: ");
+  Serial.print(tcs230.getGreen());
+  Serial.print(" Blue: ");
+  Serial.println(tcs230.getBlue());
+  delay(300);
+}
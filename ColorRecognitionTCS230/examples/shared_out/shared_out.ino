@@ -0,0 +1,56 @@
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+
+// The out pins of the four sensors are wired together to pin 2, and each 
+// sensor has its own OE, S2 and S3 pins. They take turns on the out pin, one
+// gate each, so a single external interrupt serves all of them.
+#define SENSORS 4
+
+ColorRecognitionTCS230 tcs230[SENSORS];
+
+// OE, S2 and S3 of each sensor.
+const unsigned char pins[SENSORS][3] = {
+  {22, 23, 24},
+  {25, 26, 27},
+  {28, 29, 30},
+  {31, 32, 33}
+};
+
+void setup() {
+  Serial.begin(9600);
+  
+  for (unsigned char i = 0; i < SENSORS; i++) {
+    tcs230[i].setGateTime(20);
+    tcs230[i].initializeShared(2, pins[i][0], pins[i][1], pins[i][2]);
+  }
+  
+  Serial.print("Adjusting the white balance... show something white to the sensors.");
+  
+  // All the sensors are balanced together, during 2 to 9 frames of 240ms.
+  for (unsigned char i = 0; i < SENSORS; i++) {
+    tcs230[i].startWhiteBalance();
+  }
+  bool done = false;
+  while (!done) {
+    done = true;
+    for (unsigned char i = 0; i < SENSORS; i++) {
+      if (!tcs230[i].updateWhiteBalance()) {
+        done = false;
+      }
+    }
+  }
+}
+
+void loop() {
+  for (unsigned char i = 0; i < SENSORS; i++) {
+    Serial.print(i);
+    Serial.print(" Red: ");
+    Serial.print(tcs230[i].getRed());
+    Serial.print(" Green: ");
+    Serial.print(tcs230[i].getGreen());
+    Serial.print(" Blue: ");
+    Serial.println(tcs230[i].getBlue());
+  }
+  delay(300);
+}
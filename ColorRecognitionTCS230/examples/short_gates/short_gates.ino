@@ -0,0 +1,34 @@
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230.h>
+
+// 10ms gates with the auto ranging (S0 on 8, S1 on 9). The sensor settles
+// 1ms after each filter switch, so the edges of the old photodiodes are not
+// counted in the short gates: about 30 frames per second.
+ColorRecognitionTCS230 tcs230;
+
+void setup() {
+  Serial.begin(115200);
+  
+  tcs230.setGateTime(10);
+  tcs230.setSettleTime(1);
+  tcs230.initialize(2, 4, 5, 8, 9);
+  tcs230.enableAutoRange();
+  
+  Serial.print("Adjusting the white balance... show something white to the sensor.");
+  tcs230.adjustWhiteBalance();
+}
+
+void loop() {
+  ColorRecognitionFrame frame;
+  
+  if (tcs230.drain(&frame, 1) == 1) {
+    Serial.print(frame.sequence);
+    Serial.print(": ");
+    Serial.print(frame.frequencies[0]);
+    Serial.print(" ");
+    Serial.print(frame.frequencies[1]);
+    Serial.print(" ");
+    Serial.println(frame.frequencies[2]);
+  }
+}
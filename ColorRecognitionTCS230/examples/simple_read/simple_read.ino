@@ -10,7 +10,7 @@ void setup() {
   
   Serial.print("Adjusting the white balance... show something white to the sensor.");
   
-  // Show something white to it during 4 seconds.
+  // Show something white to it until it returns, from 2 to 9 frames.
   tcs230->adjustWhiteBalance();
   
   while (1) {
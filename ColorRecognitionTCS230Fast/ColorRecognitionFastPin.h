@@ -0,0 +1,168 @@
+/**
+ * Arduino - Color Recognition Sensor
+ *
+ * ColorRecognitionFastPin.h
+ *
+ * Maps the Arduino pins to their ports, bits and external interrupts at
+ * compile time.
+ *
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_FAST_PIN_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_FAST_PIN_H__ 1
+
+#include <Arduino.h>
+
+/**
+ * The core maps the pins to the ports with PROGMEM tables, read at run time.
+ * These are the same tables as constant expressions, for the boards below,
+ * so the ports and the masks of pins known at compile time fold into the
+ * instructions.
+ *
+ * The ports are numbered from 1 (port A), 0 is not a pin. The interrupts are
+ * the n of the INTn vectors, not the numbers of attachInterrupt().
+ *
+ * <pre>
+ * BOARD                    MCU
+ * Uno, Nano, Pro Mini      ATmega328P, ATmega168
+ * Mega                     ATmega2560, ATmega1280
+ * Leonardo, Micro          ATmega32U4
+ * </pre>
+ */
+
+/**
+ * Not a pin of the board, as a port.
+ */
+#define FAST_NOT_A_PORT 0
+
+/**
+ * Not an external interrupt pin, as an interrupt.
+ */
+#define FAST_NOT_AN_INTERRUPT 0xff
+
+class ColorRecognitionFastPin {
+public:
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+
+    static constexpr unsigned char getPort(unsigned char pin) {
+        return pin < 8 ? 4 : (pin < 14 ? 2 : (pin < 20 ? 3 : FAST_NOT_A_PORT));
+    }
+
+    static constexpr unsigned char getMask(unsigned char pin) {
+        return 1 << (pin < 8 ? pin : (pin < 14 ? pin - 8 : pin - 14));
+    }
+
+    static constexpr unsigned char getInterrupt(unsigned char pin) {
+        return pin == 2 ? 0 : (pin == 3 ? 1 : FAST_NOT_AN_INTERRUPT);
+    }
+
+#elif defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+
+    static constexpr unsigned char getPort(unsigned char pin) {
+        return pin < 70 ? "EEEEGEHHHHBBBBJJHHDDDDAAAAAAAACCCCCCCCDGGGLLLLLLLLBBBBFFFFFFFFKKKKKKKK"[pin] - 'A' + 1
+                : FAST_NOT_A_PORT;
+    }
+
+    static constexpr unsigned char getMask(unsigned char pin) {
+        return pin < 70 ? 1 << ("0145533456456710103210012345677654321072107654321032100123456701234567"[pin] - '0')
+                : 0;
+    }
+
+    static constexpr unsigned char getInterrupt(unsigned char pin) {
+        return pin == 2 ? 4 : (pin == 3 ? 5 : (pin >= 18 && pin <= 21 ? 21 - pin : FAST_NOT_AN_INTERRUPT));
+    }
+
+#elif defined(__AVR_ATmega32U4__)
+
+    static constexpr unsigned char getPort(unsigned char pin) {
+        return pin < 24 ? "DDDDDCDEBBBBDCBBBBFFFFFF"[pin] - 'A' + 1 : FAST_NOT_A_PORT;
+    }
+
+    static constexpr unsigned char getMask(unsigned char pin) {
+        return pin < 24 ? 1 << ("231046764567673120765410"[pin] - '0') : 0;
+    }
+
+    static constexpr unsigned char getInterrupt(unsigned char pin) {
+        return pin == 3 ? 0 : (pin == 2 ? 1 : (pin == 0 ? 2 : (pin == 1 ? 3 : (pin == 7 ? 6
+                : FAST_NOT_AN_INTERRUPT))));
+    }
+
+#elif defined(SIMULATED_PORTS)
+
+    // The host HAL groups the pins by 8, and attaches its interrupts.
+
+    static constexpr unsigned char getPort(unsigned char pin) {
+        return digitalPinToPort(pin);
+    }
+
+    static constexpr unsigned char getMask(unsigned char pin) {
+        return digitalPinToBitMask(pin);
+    }
+
+#else
+#error "ColorRecognitionFastPin has no pin map for this board."
+#endif
+
+    /**
+     * Returns the output register of a port. With a constant port, it folds
+     * to the register address.
+     *
+     * @param port          The port, 1 for port A.
+     * @return              The output register.
+     */
+    static inline volatile uint8_t& getOutputRegister(unsigned char port) {
+#if defined(SIMULATED_PORTS)
+        return simulatedPorts[port];
+#else
+        switch (port) {
+#if defined(PORTA)
+        case 1:
+            return PORTA;
+#endif
+#if defined(PORTC)
+        case 3:
+            return PORTC;
+#endif
+#if defined(PORTD)
+        case 4:
+            return PORTD;
+#endif
+#if defined(PORTE)
+        case 5:
+            return PORTE;
+#endif
+#if defined(PORTF)
+        case 6:
+            return PORTF;
+#endif
+#if defined(PORTG)
+        case 7:
+            return PORTG;
+#endif
+#if defined(PORTH)
+        case 8:
+            return PORTH;
+#endif
+#if defined(PORTJ)
+        case 10:
+            return PORTJ;
+#endif
+#if defined(PORTK)
+        case 11:
+            return PORTK;
+#endif
+#if defined(PORTL)
+        case 12:
+            return PORTL;
+#endif
+        default:
+            // Port B, which all the boards have.
+            return PORTB;
+        }
+#endif
+    }
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_FAST_PIN_H__ */
@@ -0,0 +1,436 @@
+/**
+ * Arduino - Color Recognition Sensor
+ *
+ * ColorRecognitionTCS230Fast.h
+ *
+ * The Color Recognition TCS230 sensor, counted by interrupts, with its pins
+ * fixed at compile time.
+ *
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_FAST_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_FAST_H__ 1
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionScale.h>
+#include "ColorRecognitionFastPin.h"
+
+/**
+ * In this driver we are assuming the S0 pin is LOW and S1 pin is HIGH. With
+ * output frequency at 2%. Also we are assuming the OE pin is LOW.
+ *
+ * Compile-time pins:
+ *
+ * ColorRecognitionTCS230 takes its pins at run time, so each edge goes
+ * through the attachInterrupt() dispatch and the table of the interrupt
+ * lines, and the ports of the filter pins are looked up by initialize() and
+ * written through pointers. Here the out, s2 and s3 pins are template
+ * parameters: the ports and masks are constants, the timer interrupt
+ * switches the filter with one write to the port of s2 and s3 (two when
+ * they are on different ports), and the edge interrupt is bound to its
+ * vector, where it only increments the count.
+ *
+ * It does the red, green and blue gates of the original driver, with the
+ * same gate time, and the white balance. The scaling, the clear gate, the
+ * frame buffer and the shared out lines are left to ColorRecognitionTCS230.
+ *
+ * NOTE: The sketch binds the edge vector once, with
+ * COLOR_RECOGNITION_TCS230_FAST_ISR(). The vector is INTn, n being the
+ * external interrupt of the out pin:
+ *
+ * <pre>
+ * BOARD        OUT PIN  VECTOR
+ * Uno          2        INT0_vect
+ *              3        INT1_vect
+ * Mega         2        INT4_vect
+ *              3        INT5_vect
+ *              18..21   INT3_vect..INT0_vect
+ * Leonardo     3        INT0_vect
+ *              2        INT1_vect
+ *              0, 1     INT2_vect, INT3_vect
+ *              7        INT6_vect
+ * </pre>
+ *
+ * As the core defines all the INTn vectors along with attachInterrupt(),
+ * the sketch cannot use attachInterrupt(), nor ColorRecognitionTCS230. This
+ * driver owns Timer1 through the TimerOne library.
+ */
+
+/**
+ * The default gate time, in milliseconds.
+ */
+#ifndef FAST_DEFAULT_GATE_TIME_IN_MS
+#define FAST_DEFAULT_GATE_TIME_IN_MS 100
+#endif
+
+/**
+ * How many frames adjustWhiteBalance() averages, after skipping the one
+ * being acquired when it is called.
+ */
+#ifndef FAST_WHITE_BALANCE_FRAMES
+#define FAST_WHITE_BALANCE_FRAMES 4
+#endif
+
+/**
+ * The default white balance frequency, in Hz.
+ */
+#ifndef MAX_FRQUENCY_IN_HZ
+#define MAX_FRQUENCY_IN_HZ 1000
+#endif
+
+/**
+ * The 100% output frequency over the 2% one this driver assumes.
+ */
+#define FAST_SCALING 50
+
+/**
+ * Binds the edge interrupt of a ColorRecognitionTCS230Fast to its vector.
+ * It goes at the top level of the sketch, once.
+ *
+ * @param vector        The INTn vector of the out pin.
+ * @param ...           The ColorRecognitionTCS230Fast type.
+ */
+#define COLOR_RECOGNITION_TCS230_FAST_ISR(vector, ...) ISR(vector) { __VA_ARGS__::countEdge(); }
+
+template<unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin>
+class ColorRecognitionTCS230Fast: public ColorRecognition {
+private:
+
+    static_assert(ColorRecognitionFastPin::getPort(s2Pin) != FAST_NOT_A_PORT
+            && ColorRecognitionFastPin::getPort(s3Pin) != FAST_NOT_A_PORT, "s2 and s3 must be pins of the board");
+#if defined(EIMSK)
+    static_assert(ColorRecognitionFastPin::getInterrupt(outPin) != FAST_NOT_AN_INTERRUPT,
+            "out must be an external interrupt pin");
+#endif
+
+    /**
+     * The ports and masks of the s2 and s3 pins.
+     */
+    static const unsigned char s2Port = ColorRecognitionFastPin::getPort(s2Pin);
+    static const unsigned char s3Port = ColorRecognitionFastPin::getPort(s3Pin);
+    static const unsigned char s2Mask = ColorRecognitionFastPin::getMask(s2Pin);
+    static const unsigned char s3Mask = ColorRecognitionFastPin::getMask(s3Pin);
+
+    /**
+     * The edges counted in the current gate.
+     */
+    volatile unsigned long count;
+
+    /**
+     * The gate time, in milliseconds.
+     */
+    unsigned int gateTime;
+
+    /**
+     * If the driver is initialized.
+     */
+    bool initialized;
+
+    /**
+     * Holds the count of the last gate, for each filter.
+     */
+    volatile unsigned long lastCounts[3];
+
+    /**
+     * How many frames have been measured, wrapping at 256.
+     */
+    volatile unsigned char frames;
+
+    /**
+     * Holds the white balance, as the scale factors of each filter, in Hz
+     * at the 100% scaling.
+     */
+    ColorRecognitionScale whiteBalance;
+
+    /**
+     * Singleton. The instance.
+     */
+    static ColorRecognitionTCS230Fast instance;
+
+public:
+
+    /**
+     * Filter color enumeration.
+     */
+    enum Filter {
+        RED_FILTER,
+        GREEN_FILTER,
+        BLUE_FILTER,
+        CLEAR_FILTER
+    };
+
+    /**
+     * Current filter.
+     */
+    volatile Filter currentFilter;
+
+    /**
+     * Singleton. Gets the instance of the driver.
+     *
+     * @return
+     */
+    static ColorRecognitionTCS230Fast* getInstance() {
+        return &instance;
+    }
+
+    virtual ~ColorRecognitionTCS230Fast() {
+    }
+
+    /**
+     * Sets the gate time of each filter. It is taken by initialize().
+     *
+     * @param gateTime      The gate time, in milliseconds.
+     */
+    void setGateTime(unsigned int gateTime) {
+        this->gateTime = (gateTime == 0) ? 1 : gateTime;
+    }
+
+    /**
+     * Initializes the IO, the edge interrupt and Timer1.
+     */
+    void initialize();
+
+    /**
+     * Store the current read as the maximum frequency for each color.
+     *
+     * It tells what is considered white. The frame being acquired is
+     * skipped, as it started before the call, and the next
+     * FAST_WHITE_BALANCE_FRAMES frames are averaged. It returns at once if
+     * the driver is not initialized.
+     */
+    void adjustWhiteBalance();
+
+    /**
+     * Returns how many frames have been measured, wrapping at 256. A new
+     * frame is there when it differs from the last value read.
+     *
+     * @return              The frame count.
+     */
+    unsigned char getFrameCount() {
+        return frames;
+    }
+
+    /**
+     * Returns the last measured frequency of one filter.
+     *
+     * @param filter        The filter.
+     * @return              The frequency, in Hz at the 100% scaling.
+     */
+    long getFrequency(Filter filter);
+
+    /**
+     * Returns the red color intensity.
+     *
+     * @retun               The red color intensity.
+     */
+    unsigned char getRed() {
+        return whiteBalance.toIntensity(0, getFrequency(RED_FILTER));
+    }
+
+    /**
+     * Returns the green color intensity.
+     *
+     * @retun               The green color intensity.
+     */
+    unsigned char getGreen() {
+        return whiteBalance.toIntensity(1, getFrequency(GREEN_FILTER));
+    }
+
+    /**
+     * Returns the blue color intensity.
+     *
+     * @retun               The blue color intensity.
+     */
+    unsigned char getBlue() {
+        return whiteBalance.toIntensity(2, getFrequency(BLUE_FILTER));
+    }
+
+    /**
+     * Fills the red, green and blue intensities.
+     *
+     * @param buf           The buffer to fill.
+     * @return              True.
+     */
+    bool fillRGB(unsigned char buf[3]) {
+        long frequencies[3];
+        fillFrequencies(frequencies);
+        whiteBalance.toIntensities(frequencies, buf);
+        return true;
+    }
+
+    /**
+     * Fills the red, green and blue intensities with 16 bits.
+     *
+     * @param buf           The buffer to fill.
+     * @return              True.
+     */
+    bool fillRGB16(unsigned int buf[3]) {
+        long frequencies[3];
+        fillFrequencies(frequencies);
+        whiteBalance.toIntensities16(frequencies, buf);
+        return true;
+    }
+
+    /**
+     * Fills the red, green and blue frequencies of the last frame, in Hz at
+     * the 100% scaling.
+     *
+     * @param buf           The buffer to fill.
+     * @return              True.
+     */
+    bool fillFrequencies(long buf[3]) {
+        buf[0] = getFrequency(RED_FILTER);
+        buf[1] = getFrequency(GREEN_FILTER);
+        buf[2] = getFrequency(BLUE_FILTER);
+        return true;
+    }
+
+    /**
+     * Counts an edge of the out pin. Called from the vector bound by
+     * COLOR_RECOGNITION_TCS230_FAST_ISR().
+     *
+     * NOTE: It is public only to be reachable from the interrupt vector.
+     */
+    static inline void countEdge() {
+        instance.count++;
+    }
+
+    /**
+     * Timer interruption handler. Ends the gate of the current filter and
+     * starts the next one.
+     *
+     * NOTE: It is public only to be reachable from the TimerOne callback.
+     */
+    static void timerInterruptHandler();
+
+private:
+
+    /**
+     * Private constructor.
+     */
+    ColorRecognitionTCS230Fast()
+            : count(0), gateTime(FAST_DEFAULT_GATE_TIME_IN_MS), initialized(false), frames(0),
+              whiteBalance((long) MAX_FRQUENCY_IN_HZ * FAST_SCALING), currentFilter(RED_FILTER) {
+        for (unsigned char i = 0; i < 3; i++) {
+            lastCounts[i] = 0;
+        }
+    }
+
+    /**
+     * Sets the s2 and s3 pins according of the color passed as filter, with
+     * one read-modify-write of their port when they share it. Must be
+     * called with the interrupts disabled.
+     *
+     * <pre>
+     * S2   S3  PHOTODIODE TYPE
+     * L    L   Red
+     * L    H   Blue
+     * H    L   Clear (no filter)
+     * H    H   Green
+     * </pre>
+     *
+     * @param filter        The next filter.
+     */
+    static inline void setFilter(Filter filter) {
+        unsigned char s2 = (filter == CLEAR_FILTER || filter == GREEN_FILTER) ? s2Mask : 0;
+        unsigned char s3 = (filter == BLUE_FILTER || filter == GREEN_FILTER) ? s3Mask : 0;
+        instance.currentFilter = filter;
+        if (s2Port == s3Port) {
+            volatile uint8_t& port = ColorRecognitionFastPin::getOutputRegister(s2Port);
+            port = (port & ~(s2Mask | s3Mask)) | s2 | s3;
+        } else {
+            volatile uint8_t& port2 = ColorRecognitionFastPin::getOutputRegister(s2Port);
+            volatile uint8_t& port3 = ColorRecognitionFastPin::getOutputRegister(s3Port);
+            port2 = (port2 & ~s2Mask) | s2;
+            port3 = (port3 & ~s3Mask) | s3;
+        }
+    }
+};
+
+template<unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin>
+ColorRecognitionTCS230Fast<outPin, s2Pin, s3Pin> ColorRecognitionTCS230Fast<outPin, s2Pin, s3Pin>::instance;
+
+template<unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin>
+void ColorRecognitionTCS230Fast<outPin, s2Pin, s3Pin>::initialize() {
+    pinMode(s2Pin, OUTPUT);
+    pinMode(s3Pin, OUTPUT);
+    pinMode(outPin, INPUT);
+    noInterrupts();
+    setFilter(RED_FILTER);
+    count = 0;
+#if defined(EIMSK)
+    // Rising edges, on the INTn the sketch binds.
+    const unsigned char line = ColorRecognitionFastPin::getInterrupt(outPin);
+#if defined(EICRB)
+    if (line >= 4) {
+        EICRB = (EICRB & ~(3 << ((line - 4) * 2))) | (3 << ((line - 4) * 2));
+    } else
+#endif
+    {
+        EICRA = (EICRA & ~(3 << (line * 2))) | (3 << (line * 2));
+    }
+    EIFR = _BV(line);
+    EIMSK |= _BV(line);
+#else
+    attachInterrupt(digitalPinToInterrupt(outPin), countEdge, RISING);
+#endif
+    interrupts();
+    Timer1.initialize(gateTime * 1000L);
+    Timer1.attachInterrupt(timerInterruptHandler);
+    initialized = true;
+}
+
+template<unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin>
+void ColorRecognitionTCS230Fast<outPin, s2Pin, s3Pin>::adjustWhiteBalance() {
+    long sums[3] = { 0, 0, 0 };
+    unsigned char frame = frames;
+    if (!initialized) {
+        return;
+    }
+    for (unsigned char n = 0; n <= FAST_WHITE_BALANCE_FRAMES; n++) {
+        while (frames == frame) {
+            delay(1);
+        }
+        frame = frames;
+        // The first frame started before the call, and is skipped.
+        for (unsigned char i = 0; n > 0 && i < 3; i++) {
+            sums[i] += getFrequency((Filter) i);
+        }
+    }
+    for (unsigned char i = 0; i < 3; i++) {
+        whiteBalance.setWhite(i, sums[i] / FAST_WHITE_BALANCE_FRAMES);
+    }
+}
+
+template<unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin>
+long ColorRecognitionTCS230Fast<outPin, s2Pin, s3Pin>::getFrequency(Filter filter) {
+    unsigned long hertz;
+    if (filter == CLEAR_FILTER) {
+        return 0;
+    }
+    noInterrupts();
+    hertz = lastCounts[filter] * 1000;
+    interrupts();
+    // hertz * FAST_SCALING / gateTime, scaled after the integer part so the
+    // product fits 32 bits.
+    return (hertz / gateTime) * FAST_SCALING + ((hertz % gateTime) * FAST_SCALING + (gateTime >> 1)) / gateTime;
+}
+
+template<unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin>
+void ColorRecognitionTCS230Fast<outPin, s2Pin, s3Pin>::timerInterruptHandler() {
+    Filter filter = instance.currentFilter;
+    unsigned long count = instance.count;
+    // The next gate counts from here.
+    instance.count = 0;
+    setFilter((filter == BLUE_FILTER) ? RED_FILTER : (Filter) (filter + 1));
+    instance.lastCounts[filter] = count;
+    if (filter == BLUE_FILTER) {
+        instance.frames++;
+    }
+}
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_FAST_H__ */
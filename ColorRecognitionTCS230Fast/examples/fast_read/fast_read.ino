@@ -0,0 +1,35 @@
+#include <TimerOne.h>
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230Fast.h>
+
+// Out on pin 2, s2 on pin 4 and s3 on pin 5.
+typedef ColorRecognitionTCS230Fast<2, 4, 5> Sensor;
+
+// Pin 2 is INT0 on the Uno, use INT4_vect on the Mega.
+COLOR_RECOGNITION_TCS230_FAST_ISR(INT0_vect, Sensor)
+
+void setup() {
+  Serial.begin(9600);
+  
+  Sensor* tcs230 = Sensor::getInstance();
+  tcs230->setGateTime(20);
+  tcs230->initialize();
+  
+  Serial.print("Adjusting the white balance... show something white to the sensor.");
+  
+  // Show something white to it until it returns, 5 frames.
+  tcs230->adjustWhiteBalance();
+  
+  while (1) {
+    Serial.print("Red: ");
+    Serial.println(tcs230->getRed());
+    Serial.print("Green: ");
+    Serial.println(tcs230->getGreen());
+    Serial.print("Blue ");
+    Serial.println(tcs230->getBlue());
+    delay(100);
+  }
+}
+
+void loop() {
+}
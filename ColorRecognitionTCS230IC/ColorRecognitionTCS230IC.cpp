@@ -0,0 +1,209 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionTCS230IC.cpp
+ * 
+ * The Color Recognition TCS230 sensor, measured by reciprocal counting with
+ * the Timer1 input capture unit.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_IC_CPP__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_IC_CPP__ 1
+
+#include "ColorRecognitionTCS230IC.h"
+#include <Arduino.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/**
+ * Timer1 overflows (65536 CPU ticks each) before a filter times out.
+ */
+#define CAPTURE_TIMEOUT_OVERFLOWS ((unsigned int) (((CAPTURE_TIMEOUT_IN_MS * (F_CPU / 1000L)) >> 16) + 1))
+
+ColorRecognitionTCS230IC ColorRecognitionTCS230IC::instance;
+
+ISR(TIMER1_CAPT_vect) {
+    ColorRecognitionTCS230IC::captureInterruptHandler();
+}
+
+ISR(TIMER1_OVF_vect) {
+    ColorRecognitionTCS230IC::overflowInterruptHandler();
+}
+
+void ColorRecognitionTCS230IC::initialize(unsigned char s2Pin, unsigned char s3Pin, unsigned char periods) {
+    this->s2Pin = s2Pin;
+    this->s3Pin = s3Pin;
+    setPeriods(periods);
+    pinMode(s2Pin, OUTPUT);
+    pinMode(s3Pin, OUTPUT);
+    pinMode(ICP1_PIN, INPUT);
+    cli();
+    setFilter(RED_FILTER);
+    captured = -1;
+    overflows = 0;
+    timeoutOverflows = CAPTURE_TIMEOUT_OVERFLOWS;
+
+    // Normal mode, input noise canceler, rising edge, no prescaling.
+    TCCR1A = 0;
+    TCCR1B = _BV(ICNC1) | _BV(ICES1) | _BV(CS10);
+    TCNT1 = 0;
+    TIFR1 = _BV(ICF1) | _BV(TOV1);
+    TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+    sei();
+}
+
+void ColorRecognitionTCS230IC::setPeriods(unsigned char periods) {
+    if (periods < 1) {
+        periods = 1;
+    } else if (periods > 127) {
+        periods = 127;
+    }
+    this->periods = periods;
+}
+
+void ColorRecognitionTCS230IC::adjustWhiteBalance() {
+    long sums[3] = { 0, 0, 0 };
+    unsigned char frame = frames;
+    if ((TIMSK1 & _BV(ICIE1)) == 0) {
+        return;
+    }
+    for (unsigned char n = 0; n <= CAPTURE_WHITE_BALANCE_FRAMES; n++) {
+        while (frames == frame) {
+            delay(1);
+        }
+        frame = frames;
+        // The first frame started before the call, and is skipped.
+        for (unsigned char i = 0; n > 0 && i < 3; i++) {
+            sums[i] += getScaledFrequency((Filter) i);
+        }
+    }
+    for (unsigned char i = 0; i < 3; i++) {
+        whiteBalance.setWhite(i, sums[i] / CAPTURE_WHITE_BALANCE_FRAMES);
+    }
+}
+
+unsigned char ColorRecognitionTCS230IC::getFrameCount() {
+    return frames;
+}
+
+void ColorRecognitionTCS230IC::captureInterruptHandler() {
+    unsigned int capture = ICR1;
+    unsigned int high = instance.overflows;
+    unsigned long timestamp;
+
+    // An overflow pending while the capture happened right after the wrap
+    // has not been counted yet.
+    if ((TIFR1 & _BV(TOV1)) && capture < 0x8000) {
+        high++;
+    }
+    timestamp = ((unsigned long) high << 16) | capture;
+    if (instance.captured < 0) {
+        instance.firstCapture = timestamp;
+        instance.captured = 0;
+        return;
+    }
+    instance.lastCapture = timestamp;
+    if (++instance.captured >= (signed char) instance.periods) {
+        nextFilter(timestamp - instance.firstCapture);
+    }
+}
+
+void ColorRecognitionTCS230IC::overflowInterruptHandler() {
+    instance.overflows++;
+    if (instance.overflows == instance.timeoutOverflows) {
+        // A slow signal is measured over the periods captured so far.
+        nextFilter(instance.captured > 0 ? instance.lastCapture - instance.firstCapture : 0);
+    }
+}
+
+void ColorRecognitionTCS230IC::nextFilter(unsigned long ticks) {
+    Filter filter = instance.currentFilter;
+    instance.lastTicks[filter] = ticks;
+    instance.lastPeriods[filter] = (ticks == 0) ? 0 : instance.captured;
+    if (filter == BLUE_FILTER) {
+        instance.frames++;
+    }
+    setFilter((filter == BLUE_FILTER) ? RED_FILTER : (Filter) (filter + 1));
+    instance.captured = -1;
+    instance.timeoutOverflows = instance.overflows + CAPTURE_TIMEOUT_OVERFLOWS;
+}
+
+long ColorRecognitionTCS230IC::getFrequency(Filter filter) {
+    return (getScaledFrequency(filter) + (CAPTURE_SCALING >> 1)) / CAPTURE_SCALING;
+}
+
+long ColorRecognitionTCS230IC::getScaledFrequency(Filter filter) {
+    unsigned long ticks, cycles;
+    unsigned char periods;
+    if (filter == CLEAR_FILTER) {
+        return 0;
+    }
+
+    // The ISR may update the measure while it is read, so read until two
+    // consecutive reads agree instead of disabling the interrupts.
+    do {
+        ticks = lastTicks[filter];
+        periods = lastPeriods[filter];
+    } while (ticks != lastTicks[filter] || periods != lastPeriods[filter]);
+    if (ticks == 0) {
+        return 0;
+    }
+    // F_CPU * periods * CAPTURE_SCALING / ticks, scaled after the integer
+    // part so the product fits 32 bits.
+    cycles = (unsigned long) F_CPU * periods;
+    return (cycles / ticks) * CAPTURE_SCALING + ((cycles % ticks) * CAPTURE_SCALING + (ticks >> 1)) / ticks;
+}
+
+unsigned char ColorRecognitionTCS230IC::getIntensity(Filter filter) {
+    return whiteBalance.toIntensity(filter, getScaledFrequency(filter));
+}
+
+unsigned char ColorRecognitionTCS230IC::getRed() {
+    return getIntensity(RED_FILTER);
+}
+
+unsigned char ColorRecognitionTCS230IC::getGreen() {
+    return getIntensity(GREEN_FILTER);
+}
+
+unsigned char ColorRecognitionTCS230IC::getBlue() {
+    return getIntensity(BLUE_FILTER);
+}
+
+bool ColorRecognitionTCS230IC::fillRGB(unsigned char buf[3]) {
+    long frequencies[3];
+    fillFrequencies(frequencies);
+    whiteBalance.toIntensities(frequencies, buf);
+    return true;
+}
+
+bool ColorRecognitionTCS230IC::fillRGB16(unsigned int buf[3]) {
+    long frequencies[3];
+    fillFrequencies(frequencies);
+    whiteBalance.toIntensities16(frequencies, buf);
+    return true;
+}
+
+bool ColorRecognitionTCS230IC::fillFrequencies(long buf[3]) {
+    buf[0] = getScaledFrequency(RED_FILTER);
+    buf[1] = getScaledFrequency(GREEN_FILTER);
+    buf[2] = getScaledFrequency(BLUE_FILTER);
+    return true;
+}
+
+void ColorRecognitionTCS230IC::setFilter(Filter filter) {
+    unsigned char s2 = LOW, s3 = LOW;
+    instance.currentFilter = filter;
+    if (filter == CLEAR_FILTER || filter == GREEN_FILTER) {
+        s2 = HIGH;
+    }
+    if (filter == BLUE_FILTER || filter == GREEN_FILTER) {
+        s3 = HIGH;
+    }
+    digitalWrite(instance.s2Pin, s2);
+    digitalWrite(instance.s3Pin, s3);
+}
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_IC_CPP__ */
@@ -0,0 +1,344 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ColorRecognitionTCS230IC.h
+ * 
+ * The Color Recognition TCS230 sensor, measured by reciprocal counting with
+ * the Timer1 input capture unit.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_IC_H__
+#define __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_IC_H__ 1
+
+#include <ColorRecognition.h>
+#include <ColorRecognitionScale.h>
+
+/**
+ * In this driver we are assuming the S0 pin is LOW and S1 pin is HIGH. With
+ * output frequency at 2%. Also we are assuming the OE pin is LOW.
+ * 
+ * Reciprocal counting:
+ * 
+ * Instead of counting edges during a fixed gate (where up to one count is
+ * lost on each gate, so the resolution is 1 / (frequency * gate)), this
+ * driver timestamps the rising edges of the out pin with the Timer1 input
+ * capture unit, running at the CPU clock. The time of N whole periods is
+ * measured and the frequency is N * F_CPU / ticks. The resolution is one CPU
+ * clock over the measured time: at 16MHz, 16 periods of a 1KHz signal (16ms)
+ * are resolved to about 4 ppm, where a 1 second gate resolves 1000 ppm.
+ * 
+ * The timestamps are extended to 32 bits with the Timer1 overflow interrupt.
+ * 
+ * NOTE: The out pin must be wired to the ICP1 pin, ICP1_PIN (digital pin 8 
+ * on the ATmega328P boards, 4 on the ATmega32U4 ones). This driver owns Timer1, so it
+ * cannot be used together with the TimerOne library or ColorRecognitionTCS230.
+ */
+
+/**
+ * The ICP1 pin, the out pin.
+ */
+#ifndef ICP1_PIN
+#if defined(__AVR_ATmega32U4__)
+#define ICP1_PIN 4
+#else
+#define ICP1_PIN 8
+#endif
+#endif
+
+/**
+ * The default number of whole periods measured for each filter.
+ */
+#define DEFAULT_PERIODS 16
+
+/**
+ * How long, in milliseconds, a filter waits for its periods. On timeout the
+ * frequency comes from the periods captured so far, and a filter without 
+ * any reads as dark (frequency 0).
+ */
+#define CAPTURE_TIMEOUT_IN_MS 250
+
+/**
+ * How many frames adjustWhiteBalance() averages, after skipping the one 
+ * being acquired when it is called.
+ */
+#ifndef CAPTURE_WHITE_BALANCE_FRAMES
+#define CAPTURE_WHITE_BALANCE_FRAMES 4
+#endif
+
+/**
+ * The default white balance frequency, in Hz.
+ */
+#ifndef MAX_FRQUENCY_IN_HZ
+#define MAX_FRQUENCY_IN_HZ 1000
+#endif
+
+/**
+ * The 100% output frequency over the 2% one this driver assumes.
+ */
+#define CAPTURE_SCALING 50
+
+class ColorRecognitionTCS230IC: public ColorRecognition {
+private:
+
+    /**
+     * The s2 pin.
+     */
+    unsigned char s2Pin;
+
+    /**
+     * The s3 pin.
+     */
+    unsigned char s3Pin;
+
+    /**
+     * How many whole periods are measured for each filter.
+     */
+    unsigned char periods;
+
+    /**
+     * How many periods have been captured for the current filter. Negative
+     * while waiting for the first edge.
+     */
+    volatile signed char captured;
+
+    /**
+     * The high 16 bits of the timestamps, incremented on each overflow.
+     */
+    volatile unsigned int overflows;
+
+    /**
+     * The overflow count at which the current filter times out.
+     */
+    volatile unsigned int timeoutOverflows;
+
+    /**
+     * The timestamp of the first edge of the current filter.
+     */
+    unsigned long firstCapture;
+
+    /**
+     * The timestamp of the last edge of the current filter.
+     */
+    unsigned long lastCapture;
+
+    /**
+     * Holds the CPU ticks of the last measured periods, for each filter.
+     */
+    volatile unsigned long lastTicks[3];
+
+    /**
+     * Holds the number of periods of the last measure, for each filter.
+     */
+    volatile unsigned char lastPeriods[3];
+
+    /**
+     * How many frames have been measured, wrapping at 256.
+     */
+    volatile unsigned char frames;
+
+    /**
+     * Holds the white balance, as the scale factors of each filter, in Hz
+     * at the 100% scaling.
+     */
+    ColorRecognitionScale whiteBalance;
+
+    /**
+     * Singleton. The instance.
+     */
+    static ColorRecognitionTCS230IC instance;
+
+public:
+
+    /**
+     * Filter color enumeration.
+     */
+    enum Filter {
+        RED_FILTER,
+        GREEN_FILTER,
+        BLUE_FILTER,
+        CLEAR_FILTER
+    };
+
+    /**
+     * Current filter.
+     */
+    volatile Filter currentFilter;
+
+    /**
+     * Singleton. Gets the instance of the driver.
+     *
+     * @return
+     */
+    static ColorRecognitionTCS230IC* getInstance() {
+        return &ColorRecognitionTCS230IC::instance;
+    }
+
+    virtual ~ColorRecognitionTCS230IC() {
+    }
+
+    /**
+     * Initializes the IO and Timer1.
+     *
+     * @param s2Pin                 The s2 pin.
+     * @param s3Pin                 The s3 pin.
+     * @param periods               How many whole periods are measured for
+     *                              each filter (1 to 127).
+     */
+    void initialize(unsigned char s2Pin, unsigned char s3Pin, unsigned char periods = DEFAULT_PERIODS);
+
+    /**
+     * Sets how many whole periods are measured for each filter. More periods
+     * give more resolution and average out the jitter, at a lower frame rate.
+     *
+     * @param periods               The number of periods (1 to 127).
+     */
+    void setPeriods(unsigned char periods);
+
+    /**
+     * Store the current read as the maximum frequency for each color.
+     *
+     * It tells what is considered white. The frame being acquired is 
+     * skipped, as it started before the call, and the next 
+     * CAPTURE_WHITE_BALANCE_FRAMES frames are averaged. As each filter times
+     * out after CAPTURE_TIMEOUT_IN_MS, it never blocks for more than 
+     * (CAPTURE_WHITE_BALANCE_FRAMES + 1) * 3 * CAPTURE_TIMEOUT_IN_MS. It 
+     * returns at once if the driver is not initialized.
+     */
+    void adjustWhiteBalance();
+
+    /**
+     * Returns how many frames have been measured, wrapping at 256. A new
+     * frame is there when it differs from the last value read.
+     *
+     * @return              The frame count.
+     */
+    unsigned char getFrameCount();
+
+    /**
+     * Returns the last measured frequency of one filter.
+     *
+     * @param filter        The filter.
+     * @return              The frequency, in Hz.
+     */
+    long getFrequency(Filter filter);
+
+    /**
+     * Returns the red color intensity.
+     *
+     * @retun               The red color intensity.
+     */
+    unsigned char getRed();
+
+    /**
+     * Returns the green color intensity.
+     *
+     * @retun               The green color intensity.
+     */
+    unsigned char getGreen();
+
+    /**
+     * Returns the blue color intensity.
+     *
+     * @retun               The blue color intensity.
+     */
+    unsigned char getBlue();
+
+    /**
+     * Returns the blue color intensity.
+     *
+     * @retun               The blue color intensity.
+     */
+    bool fillRGB(unsigned char buf[3]);
+
+    /**
+     * Fills the red, green and blue intensities with 16 bits, from the 
+     * ticks of the last measures.
+     *
+     * @param buf           The buffer to fill.
+     * @return              True.
+     */
+    bool fillRGB16(unsigned int buf[3]);
+
+    /**
+     * Fills the red, green and blue frequencies of the last measures, in Hz
+     * at the 100% scaling. They are computed from the ticks, so they keep 
+     * the resolution of the reciprocal counting.
+     *
+     * @param buf           The buffer to fill.
+     * @return              True.
+     */
+    bool fillFrequencies(long buf[3]);
+
+    /**
+     * Sets the s2 and s3 pins according of the color passed as filter.
+     *
+     * <pre>
+     * S2   S3  PHOTODIODE TYPE
+     * L    L   Red
+     * L    H   Blue
+     * H    L   Clear (no filter)
+     * H    H   Green
+     * </pre>
+     *
+     * @param filter        The next filter.
+     */
+    static void setFilter(Filter filter);
+
+    /**
+     * Input capture interruption handler.
+     *
+     * NOTE: It is public only to be reachable from the interrupt vector.
+     */
+    static void captureInterruptHandler();
+
+    /**
+     * Timer1 overflow interruption handler.
+     *
+     * NOTE: It is public only to be reachable from the interrupt vector.
+     */
+    static void overflowInterruptHandler();
+
+private:
+
+    /**
+     * Private constructor.
+     */
+    ColorRecognitionTCS230IC()
+            : s2Pin(0), s3Pin(0), periods(DEFAULT_PERIODS), captured(-1), overflows(0), timeoutOverflows(0),
+              firstCapture(0), lastCapture(0), frames(0), whiteBalance((long) MAX_FRQUENCY_IN_HZ * CAPTURE_SCALING),
+              currentFilter(RED_FILTER) {
+        for (unsigned char i = 0; i < 3; i++) {
+            lastTicks[i] = 0;
+            lastPeriods[i] = 0;
+        }
+    }
+
+    /**
+     * Stores the measure of the current filter and moves to the next one.
+     *
+     * @param ticks         The CPU ticks of the measured periods, 0 if the
+     *                      filter timed out.
+     */
+    static void nextFilter(unsigned long ticks);
+
+    /**
+     * Returns the last measured frequency of one filter at the 100% 
+     * scaling, from its ticks, so the fraction of a Hz at the pin is kept.
+     *
+     * @param filter        The filter.
+     * @return              The frequency, in Hz at the 100% scaling.
+     */
+    long getScaledFrequency(Filter filter);
+
+    /**
+     * Converts a filter frequency to color intensity.
+     *
+     * @param filter        The filter.
+     * @return              The color intensity.
+     */
+    unsigned char getIntensity(Filter filter);
+};
+
+#endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_IC_H__ */
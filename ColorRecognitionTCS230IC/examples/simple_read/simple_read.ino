@@ -0,0 +1,28 @@
+#include <ColorRecognition.h>
+#include <ColorRecognitionTCS230IC.h>
+
+void setup() {
+  Serial.begin(9600);
+  
+  // The sensor out pin must be wired to ICP1 (pin 8, or 4 on the 32U4 boards).
+  ColorRecognitionTCS230IC* tcs230 = ColorRecognitionTCS230IC::getInstance();
+  tcs230->initialize(3, 4);
+  
+  Serial.print("Adjusting the white balance... show something white to the sensor.");
+  
+  // Show something white to it until it returns, 5 frames.
+  tcs230->adjustWhiteBalance();
+  
+  while (1) {
+    Serial.print("Red: ");
+    Serial.println(tcs230->getRed());
+    Serial.print("Green: ");
+    Serial.println(tcs230->getGreen());
+    Serial.print("Blue ");
+    Serial.println(tcs230->getBlue());
+    delay(100);
+  }
+}
+
+void loop() {
+}
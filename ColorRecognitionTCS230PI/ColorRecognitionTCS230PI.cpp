@@ -14,73 +14,523 @@
 #include "ColorRecognitionTCS230PI.h"
 
 ColorRecognitionTCS230PI::ColorRecognitionTCS230PI(unsigned char outPin,
-        unsigned char s2Pin, unsigned char s3Pin) {
+        unsigned char s2Pin, unsigned char s3Pin)
+        : s0Pin(NOT_WIRED), s1Pin(NOT_WIRED), outPort(0), outMask(0), filterLevels(0xff), filterSwitch(0),
+          settleTime(DEFAULT_SETTLE_TIME), balance(normalize(MAX_FRQUENCY_IN_HZ, SCALING_2)),
+          precisionSquared(0), minSamples(MIN_SAMPLES), maxSamples(0xffff), lastSampleCount(0), state(IDLE_STATE),
+          continuous(false), ready(false), channel(0), channelStart(0), channelEdge(0), pollTimeout(POLL_TIMEOUT), autoRange(false),
+          frameFilter(0), changeDetector(0) {
     this->s2Pin = s2Pin;
     this->s3Pin = s3Pin;
     this->outPin = outPin;
+    clearStatistics(&channelStatistics);
+#if COLOR_RECOGNITION_STATISTICS
+    resetStatistics();
+#endif
     pinMode(s2Pin, OUTPUT);
     pinMode(s3Pin, OUTPUT);
     pinMode(outPin, INPUT);
+#if defined(portInputRegister)
+    if (digitalPinToPort(outPin) != NOT_A_PIN) {
+        outPort = portInputRegister(digitalPinToPort(outPin));
+        outMask = digitalPinToBitMask(outPin);
+    }
+#endif
     for (unsigned char i = 0; i < 3; i++) {
-        minFrequency[i] = 0;
-        maxFrequency[i] = 1000;
+        frameFrequencies[i] = 0;
+        scalings[i] = SCALING_2;
+    }
+}
+
+ColorRecognitionTCS230PI::ColorRecognitionTCS230PI(unsigned char outPin,
+        unsigned char s2Pin, unsigned char s3Pin, unsigned char s0Pin, unsigned char s1Pin)
+        : ColorRecognitionTCS230PI(outPin, s2Pin, s3Pin) {
+    // With either pin not wired, the scaling stays fixed as in the 3 pins
+    // constructor.
+    if (s0Pin != NOT_WIRED && s1Pin != NOT_WIRED) {
+        this->s0Pin = s0Pin;
+        this->s1Pin = s1Pin;
+        pinMode(s0Pin, OUTPUT);
+        pinMode(s1Pin, OUTPUT);
     }
 }
 
 void ColorRecognitionTCS230PI::adjustWhiteBalance() {
     for (unsigned char i = 0; i < 3; i++) {
-        setFilter((Filter) i);
-        maxFrequency[i] = getFrequency(255);
+        balance.setWhite(i, measure((Filter) i, 255));
     }
 }
 
 void ColorRecognitionTCS230PI::adjustBlackBalance() {
     for (unsigned char i = 0; i < 3; i++) {
-        setFilter((Filter) i);
-        minFrequency[i] = getFrequency(255);
+        balance.setBlack(i, measure((Filter) i, 255));
+    }
+}
+
+void ColorRecognitionTCS230PI::saveCalibration(int address) {
+    ColorRecognitionCalibration calibration(CALIBRATION_DRIVER_TCS230PI);
+    calibration.setScale(&balance);
+    for (unsigned char i = 0; i < 3; i++) {
+        calibration.scalings[i] = scalings[i];
+    }
+    if (autoRange) {
+        calibration.options |= CALIBRATION_AUTO_RANGE;
+    }
+    calibration.save(address);
+}
+
+bool ColorRecognitionTCS230PI::loadCalibration(int address) {
+    ColorRecognitionCalibration calibration(CALIBRATION_DRIVER_TCS230PI);
+    if (!calibration.load(address)) {
+        return false;
+    }
+    calibration.applyScale(&balance);
+    if (s0Pin != NOT_WIRED) {
+        for (unsigned char i = 0; i < 3; i++) {
+            scalings[i] = (Scaling) calibration.scalings[i];
+        }
+        autoRange = (calibration.options & CALIBRATION_AUTO_RANGE) != 0;
     }
+    return true;
 }
 
 unsigned char ColorRecognitionTCS230PI::getRed() {
-    setFilter(RED_FILTER);
-    return (unsigned char) map(getFrequency(SAMPLES), minFrequency[0], maxFrequency[0], 0, 255);
+    return balance.toIntensity(0, measure(RED_FILTER, SAMPLES));
 }
 
 unsigned char ColorRecognitionTCS230PI::getGreen() {
-    setFilter(GREEN_FILTER);
-    return (unsigned char) map(getFrequency(SAMPLES), minFrequency[1], maxFrequency[1], 0, 255);
+    return balance.toIntensity(1, measure(GREEN_FILTER, SAMPLES));
 }
 
 unsigned char ColorRecognitionTCS230PI::getBlue() {
-    setFilter(BLUE_FILTER);
-    return (unsigned char) map(getFrequency(SAMPLES), minFrequency[2], maxFrequency[2], 0, 255);
+    return balance.toIntensity(2, measure(BLUE_FILTER, SAMPLES));
 }
 
 bool ColorRecognitionTCS230PI::fillRGB(unsigned char buf[3]) {
-    buf[0] = getRed();
-    buf[1] = getGreen();
-    buf[2] = getBlue();
+    long frequencies[3];
+    fillFrequencies(frequencies);
+    balance.toIntensities(frequencies, buf);
+    return true;
+}
+
+bool ColorRecognitionTCS230PI::fillRGB16(unsigned int buf[3]) {
+    long frequencies[3];
+    fillFrequencies(frequencies);
+    balance.toIntensities16(frequencies, buf);
+    return true;
+}
+
+bool ColorRecognitionTCS230PI::fillFrequencies(long buf[3]) {
+    buf[0] = measure(RED_FILTER, SAMPLES);
+    buf[1] = measure(GREEN_FILTER, SAMPLES);
+    buf[2] = measure(BLUE_FILTER, SAMPLES);
+    // The red filter of the next frame settles meanwhile.
+    setFilter(RED_FILTER);
+    if (frameFilter != 0) {
+        frameFilter->apply(buf, 3);
+    }
+    if (changeDetector != 0) {
+        changeDetector->update(buf, 3);
+    }
     return true;
 }
 
 void ColorRecognitionTCS230PI::setFilter(Filter filter) {
-    unsigned char s2 = LOW, s3 = LOW;
+    unsigned char s2 = LOW, s3 = LOW, s0 = LOW, s1 = LOW, levels;
+    Scaling scaling = getScaling(filter);
     if (filter == CLEAR_FILTER || filter == GREEN_FILTER) {
         s2 = HIGH;
     }
     if (filter == BLUE_FILTER || filter == GREEN_FILTER) {
         s3 = HIGH;
     }
+    if (s0Pin != NOT_WIRED) {
+        s0 = (scaling == SCALING_20 || scaling == SCALING_100) ? HIGH : LOW;
+        s1 = (scaling == SCALING_2 || scaling == SCALING_100) ? HIGH : LOW;
+    }
+    levels = s2 | (s3 << 1) | (s0 << 2) | (s1 << 3);
+    if (levels == filterLevels) {
+        return;
+    }
+    filterLevels = levels;
     digitalWrite(s2Pin, s2);
     digitalWrite(s3Pin, s3);
+    if (s0Pin != NOT_WIRED) {
+        digitalWrite(s0Pin, s0);
+        digitalWrite(s1Pin, s1);
+    }
+    filterSwitch = micros();
+}
+
+void ColorRecognitionTCS230PI::start(bool continuous) {
+    this->continuous = continuous;
+    ready = false;
+    channel = 0;
+    clearStatistics(&channelStatistics);
+    setFilter(RED_FILTER);
+    channelStart = millis();
+    state = MEASURING_STATE;
+}
+
+void ColorRecognitionTCS230PI::stop() {
+    state = IDLE_STATE;
+}
+
+bool ColorRecognitionTCS230PI::poll() {
+    unsigned long start, edge;
+    bool timed;
+    long frequency;
+    Filter ended;
+    if (state != MEASURING_STATE) {
+        return ready;
+    }
+    start = micros();
+    if (start - filterSwitch < settleTime) {
+        return ready;
+    }
+    timed = waitRisingEdge(start, pollTimeout, &edge);
+    if (timed && (channelStatistics.count == 0 || spansMissedEdges(&channelStatistics, edge - channelEdge))) {
+        // Edges were missed since the last call, the period starts here. The
+        // second wait gets what is left of the timeout, both count from the 
+        // start of the call.
+        channelEdge = edge;
+        timed = waitRisingEdge(start, pollTimeout, &edge);
+        if (timed && spansMissedEdges(&channelStatistics, edge - channelEdge)) {
+            // Timed right after its edge and still long, so the samples so
+            // far were the short ones: the channel starts over.
+            clearStatistics(&channelStatistics);
+        }
+    }
+    if (timed) {
+        addSample(&channelStatistics, edge - channelEdge);
+        channelEdge = edge;
+    }
+#if COLOR_RECOGNITION_STATISTICS
+    if (timed) {
+        driverStatistics.edges++;
+    } else {
+        driverStatistics.timeouts++;
+    }
+#endif
+    if (channelStatistics.count < SAMPLES && channelStatistics.count < maxSamples && !isPrecise(&channelStatistics)
+            && (millis() - channelStart) < CHANNEL_TIMEOUT) {
+        return ready;
+    }
+    frequency = toFrequency(&channelStatistics);
+    ended = (Filter) channel;
+    if (++channel >= 3) {
+        channel = 0;
+    }
+    if (channel != 0 || continuous) {
+        // The next filter settles while the channel that ended is computed.
+        setFilter((Filter) channel);
+    }
+    frameFrequencies[ended] = normalize(frequency, getScaling(ended));
+#if COLOR_RECOGNITION_STATISTICS
+    countMeasure(ended, frameFrequencies[ended]);
+#endif
+    if (autoRange) {
+        adjustRange(ended, frequency);
+    }
+    clearStatistics(&channelStatistics);
+    if (channel == 0) {
+        if (frameFilter != 0) {
+            frameFilter->apply(frameFrequencies, 3);
+        }
+        if (changeDetector != 0) {
+            changeDetector->update(frameFrequencies, 3);
+        }
+        ready = true;
+        if (!continuous) {
+            state = IDLE_STATE;
+            return ready;
+        }
+    }
+    channelStart = millis();
+    return ready;
+}
+
+bool ColorRecognitionTCS230PI::isReady() {
+    return ready;
+}
+
+bool ColorRecognitionTCS230PI::readRGB(unsigned char buf[3]) {
+    if (!ready) {
+        return false;
+    }
+    balance.toIntensities(frameFrequencies, buf);
+    ready = false;
+    return true;
+}
+
+void ColorRecognitionTCS230PI::setPollTimeout(unsigned long timeout) {
+    pollTimeout = timeout;
+}
+
+void ColorRecognitionTCS230PI::setSettleTime(unsigned long settleTime) {
+    this->settleTime = settleTime;
+}
+
+void ColorRecognitionTCS230PI::setScaling(Scaling scaling) {
+    if (s0Pin == NOT_WIRED) {
+        return;
+    }
+    autoRange = false;
+    scalings[0] = scaling;
+    scalings[1] = scaling;
+    scalings[2] = scaling;
+}
+
+ColorRecognitionTCS230PI::Scaling ColorRecognitionTCS230PI::getScaling(Filter filter) {
+    if (filter == CLEAR_FILTER) {
+        filter = RED_FILTER;
+    }
+    return scalings[filter];
+}
+
+void ColorRecognitionTCS230PI::enableAutoRange() {
+    if (s0Pin != NOT_WIRED) {
+        autoRange = true;
+    }
+}
+
+void ColorRecognitionTCS230PI::disableAutoRange() {
+    autoRange = false;
+}
+
+void ColorRecognitionTCS230PI::setFrameFilter(ColorRecognitionFrameFilter* filter) {
+    if (filter != 0) {
+        filter->resetChain();
+    }
+    frameFilter = filter;
+}
+
+void ColorRecognitionTCS230PI::setChangeDetector(ColorRecognitionChangeDetector* detector) {
+    if (detector != 0) {
+        detector->reset();
+    }
+    changeDetector = detector;
+}
+
+long ColorRecognitionTCS230PI::measure(Filter filter, unsigned int samples) {
+    long frequency;
+    Scaling scaling;
+    unsigned char ranges = 0;
+    do {
+        scaling = getScaling(filter);
+        setFilter(filter);
+        frequency = getFrequency(samples);
+    } while (autoRange && adjustRange(filter, frequency) && ++ranges < SCALING_100);
+    frequency = normalize(frequency, scaling);
+#if COLOR_RECOGNITION_STATISTICS
+    countMeasure(filter, frequency);
+#endif
+    return frequency;
+}
+
+#if COLOR_RECOGNITION_STATISTICS
+void ColorRecognitionTCS230PI::countMeasure(Filter filter, long frequency) {
+    driverStatistics.measures++;
+    if (frequency != 0 && frequency >= balance.getWhite(filter)) {
+        driverStatistics.saturations++;
+    }
+}
+
+void ColorRecognitionTCS230PI::getStatistics(ColorRecognitionStatistics* statistics) {
+    *statistics = driverStatistics;
+}
+
+void ColorRecognitionTCS230PI::resetStatistics() {
+    driverStatistics.since = micros();
+    driverStatistics.edges = 0;
+    driverStatistics.measures = 0;
+    driverStatistics.timeouts = 0;
+    driverStatistics.saturations = 0;
+    driverStatistics.overruns = 0;
+    driverStatistics.counterOverflows = 0;
+    driverStatistics.maxJitter = 0;
+    driverStatistics.minInterruptTime = 0xffff;
+    driverStatistics.maxInterruptTime = 0;
+}
+#endif
+
+long ColorRecognitionTCS230PI::normalize(long frequency, Scaling scaling) {
+    switch (scaling) {
+    case SCALING_2:
+        return frequency * 50;
+    case SCALING_20:
+        return frequency * 5;
+    case SCALING_100:
+        return frequency;
+    default:
+        return 0;
+    }
+}
+
+bool ColorRecognitionTCS230PI::adjustRange(Filter filter, long frequency) {
+    Scaling scaling;
+    if (filter == CLEAR_FILTER) {
+        filter = RED_FILTER;
+    }
+    scaling = scalings[filter];
+    if (scaling == POWER_DOWN) {
+        return false;
+    }
+    if (frequency > PERIOD_AUTO_RANGE_MAX_FREQUENCY) {
+        if (scaling > SCALING_2) {
+            scalings[filter] = (Scaling) (scaling - 1);
+            return true;
+        }
+    } else if (scaling < SCALING_100) {
+        frequency = normalize(frequency, scaling) / normalize(1, (Scaling) (scaling + 1));
+        if (frequency < PERIOD_AUTO_RANGE_MAX_FREQUENCY - PERIOD_AUTO_RANGE_MAX_FREQUENCY / 4) {
+            scalings[filter] = (Scaling) (scaling + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ColorRecognitionTCS230PI::setPrecision(float precision, unsigned int minSamples, unsigned int maxSamples) {
+    if (minSamples < 2) {
+        minSamples = 2;
+    }
+    if (maxSamples < minSamples) {
+        maxSamples = minSamples;
+    }
+    this->minSamples = minSamples;
+    this->maxSamples = maxSamples;
+    precisionSquared = precision * precision;
+}
+
+void ColorRecognitionTCS230PI::disablePrecision() {
+    precisionSquared = 0;
+    maxSamples = 0xffff;
+}
+
+unsigned int ColorRecognitionTCS230PI::getSampleCount() {
+    return lastSampleCount;
 }
 
 long ColorRecognitionTCS230PI::getFrequency(unsigned int samples) {
-    long frequency = 0;
-    for (unsigned int i = 0; i < samples; i++) {
-        frequency += 500000 / pulseIn(outPin, HIGH, 250000);
+    Statistics statistics;
+    unsigned long last, edge, period;
+    bool timedOut, clean = true;
+    clearStatistics(&statistics);
+    if (samples > maxSamples) {
+        samples = maxSamples;
+    }
+    while (micros() - filterSwitch < settleTime) {
+    }
+    timedOut = !waitRisingEdge(micros(), PERIOD_TIMEOUT, &last);
+    for (unsigned int i = 0; !timedOut && i < samples && !isPrecise(&statistics); i++) {
+        if (!waitRisingEdge(last, PERIOD_TIMEOUT, &edge)) {
+            timedOut = true;
+            break;
+        }
+        period = edge - last;
+        last = edge;
+        // The first period is timed right after its edge, the others after
+        // the work on the previous sample, which a short period does not 
+        // leave time for: they then span several periods, and are left out.
+        // The period after one left out is timed right after its edge too.
+        if (spansMissedEdges(&statistics, period)) {
+            if (!clean) {
+                clean = true;
+                continue;
+            }
+            // A period timed right after its edge is long as well, so the 
+            // samples so far were short ones, from the filter transition or
+            // a step to a darker color: the measure starts over from it.
+            clearStatistics(&statistics);
+        }
+        clean = false;
+        addSample(&statistics, period);
+#if COLOR_RECOGNITION_STATISTICS
+        driverStatistics.edges++;
+#endif
+    }
+#if COLOR_RECOGNITION_STATISTICS
+    if (timedOut) {
+        driverStatistics.timeouts++;
+    }
+#endif
+    return toFrequency(&statistics);
+}
+
+bool ColorRecognitionTCS230PI::readOut() {
+    if (outPort != 0) {
+        return (*outPort & outMask) != 0;
+    }
+    return digitalRead(outPin) == HIGH;
+}
+
+bool ColorRecognitionTCS230PI::waitRisingEdge(unsigned long since, unsigned long timeout, unsigned long* edge) {
+    unsigned char polls = 0;
+    while (readOut()) {
+        if (++polls == 0 && micros() - since > timeout) {
+            return false;
+        }
+    }
+    while (!readOut()) {
+        if (++polls == 0 && micros() - since > timeout) {
+            return false;
+        }
+    }
+    *edge = micros();
+    return true;
+}
+
+void ColorRecognitionTCS230PI::clearStatistics(Statistics* statistics) {
+    statistics->count = 0;
+    statistics->sum = 0;
+    statistics->first = 0;
+    statistics->deviationSum = 0;
+    statistics->deviationSquares = 0;
+}
+
+void ColorRecognitionTCS230PI::addSample(Statistics* statistics, unsigned long period) {
+    long deviation;
+    if (statistics->count == 0) {
+        statistics->first = period;
+    }
+    deviation = (long) (period - statistics->first);
+    statistics->count++;
+    statistics->sum += period;
+    statistics->deviationSum += deviation;
+    statistics->deviationSquares += (float) deviation * deviation;
+}
+
+bool ColorRecognitionTCS230PI::spansMissedEdges(Statistics* statistics, unsigned long period) {
+    unsigned long mean;
+    if (statistics->count == 0) {
+        return false;
+    }
+    mean = statistics->sum / statistics->count;
+    return period > mean + (mean >> 1);
+}
+
+bool ColorRecognitionTCS230PI::isPrecise(Statistics* statistics) {
+    float n, spread, sum;
+    if (precisionSquared == 0 || statistics->count < minSamples) {
+        return false;
+    }
+    // The squared standard error of the mean, relative to the mean, is
+    // (n * Q - D^2) / (n - 1) / S^2, so it is compared without dividing.
+    n = statistics->count;
+    spread = n * statistics->deviationSquares - (float) statistics->deviationSum * statistics->deviationSum;
+    sum = statistics->sum;
+    return spread <= precisionSquared * sum * sum * (n - 1);
+}
+
+long ColorRecognitionTCS230PI::toFrequency(Statistics* statistics) {
+    lastSampleCount = statistics->count;
+    if (statistics->sum < 2) {
+        return 0;
     }
-    return frequency / samples;
+    // 1000000 * count / sum, halved on both sides so up to 8000 periods do
+    // not overflow.
+    return (500000UL * statistics->count + (statistics->sum >> 2)) / (statistics->sum >> 1);
 }
 
 #endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230PI_CPP__ */
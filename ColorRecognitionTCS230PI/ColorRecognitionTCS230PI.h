@@ -13,10 +13,17 @@
 
 #include <Arduino.h>
 #include <ColorRecognition.h>
+#include <ColorRecognitionScale.h>
+#include <ColorRecognitionFrameFilter.h>
+#include <ColorRecognitionChangeDetector.h>
+#include <ColorRecognitionCalibration.h>
+#include <ColorRecognitionStatistics.h>
 
 /**
- * In this driver we are assuming the S0 pin is LOW and S1 pin is HIGH. With
- * output frequency at 2%. It saves arduino pins also.
+ * When the S0 and S1 pins are not given to the driver, we are assuming the S0
+ * pin is LOW and S1 pin is HIGH. With output frequency at 2%. It saves arduino
+ * pins also. When they are given, the scaling can be selected, or picked for
+ * each filter by the auto ranging.
  * 
  * <pre>
  * S0   S1  OUTPUT FREQUENCY
@@ -78,6 +85,64 @@
 
 #define SAMPLES   32
 
+/**
+ * The default minimum number of samples of the precision mode.
+ */
+#define MIN_SAMPLES 4
+
+/**
+ * The default timeout, in microseconds, of each sample taken by poll().
+ */
+#define POLL_TIMEOUT    10000
+
+/**
+ * How long, in microseconds, getFrequency() waits for an edge of the out
+ * pin. The first wait that times out ends the measure.
+ */
+#ifndef PERIOD_TIMEOUT
+#define PERIOD_TIMEOUT  250000
+#endif
+
+/**
+ * The default settle time after each filter switch, in microseconds.
+ * 
+ * After S2, S3 (or S0, S1) switch, the out pin takes up to one period of the
+ * new frequency to follow the new photodiodes, so the edges meanwhile are 
+ * left out. The filter of the next channel is switched before the channel 
+ * that ended is computed, so the settle time overlaps the computation (and,
+ * between frames of fillRGB(), the work of the caller).
+ */
+#ifndef DEFAULT_SETTLE_TIME
+#define DEFAULT_SETTLE_TIME 0
+#endif
+
+/**
+ * How long, in milliseconds, poll() tries to collect the samples of a filter
+ * before giving up on it. A filter with no samples reads as frequency 0.
+ */
+#define CHANNEL_TIMEOUT 250
+
+/**
+ * The default white balance frequency, in Hz, at the 2% scaling.
+ */
+#ifndef MAX_FRQUENCY_IN_HZ
+#define MAX_FRQUENCY_IN_HZ 1000
+#endif
+
+/**
+ * Marks the S0 and S1 pins as not wired to the arduino.
+ */
+#ifndef NOT_WIRED
+#define NOT_WIRED 0xff
+#endif
+
+/**
+ * The highest out pin frequency, in Hz, the auto ranging lets through. The 
+ * periods are timed with micros(), 4us steps at 16MHz, so the period is kept 
+ * at 400us or longer, for a 1% resolution even on a single sample.
+ */
+#define PERIOD_AUTO_RANGE_MAX_FREQUENCY 2500
+
 class ColorRecognitionTCS230PI : public ColorRecognition {
 private:
 
@@ -91,20 +156,132 @@ private:
      */
     unsigned char s3Pin;
 
+    /**
+     * The s0 pin, NOT_WIRED if fixed by the wiring.
+     */
+    unsigned char s0Pin;
+
+    /**
+     * The s1 pin, NOT_WIRED if fixed by the wiring.
+     */
+    unsigned char s1Pin;
+
     /**
      * The out pin.
      */
     unsigned char outPin;
 
     /**
-     * The minimum frequency.
+     * The input register of the out pin, so the edges are polled with a 
+     * single read, NULL when the core does not map the pins to ports.
+     */
+    volatile unsigned char* outPort;
+
+    /**
+     * The bit mask of the out pin in its input register.
+     */
+    unsigned char outMask;
+
+    /**
+     * The levels of the s2, s3, s0 and s1 pins (bits 0 to 3) last written, 
+     * so the filter is only switched, and settles, when they change.
+     */
+    unsigned char filterLevels;
+
+    /**
+     * When the filter was last switched, in microseconds.
+     */
+    unsigned long filterSwitch;
+
+    /**
+     * How long the out pin settles after a filter switch, in microseconds.
+     */
+    unsigned long settleTime;
+
+    /**
+     * Holds the black and white balance, as the scale factors of each 
+     * filter.
+     */
+    ColorRecognitionScale balance;
+
+    /**
+     * The running statistics of the periods sampled for a measure.
+     * 
+     * The deviations are taken from the first period, so the sum of their
+     * squares stays small for a stable signal and the variance does not 
+     * lose precision in float.
+     */
+    struct Statistics {
+        unsigned int count;
+        unsigned long sum;
+        unsigned long first;
+        long deviationSum;
+        float deviationSquares;
+    };
+
+    /**
+     * The relative precision, squared, the precision mode stops at. 0 when 
+     * the precision mode is disabled.
+     */
+    float precisionSquared;
+
+    /**
+     * The sample caps of the precision mode.
+     */
+    unsigned int minSamples;
+    unsigned int maxSamples;
+
+    /**
+     * How many samples the last measure used.
+     */
+    unsigned int lastSampleCount;
+
+    /**
+     * The asynchronous acquisition state.
      */
-    long minFrequency[3];
+    enum State {
+        IDLE_STATE, MEASURING_STATE
+    } state;
 
     /**
-     * The maximum frequency.
+     * Whether a new frame is started when one completes.
      */
-    long maxFrequency[3];
+    bool continuous;
+
+    /**
+     * Whether a complete frame is available.
+     */
+    bool ready;
+
+    /**
+     * The channel being acquired by poll().
+     */
+    unsigned char channel;
+
+    /**
+     * The statistics of the channel being acquired by poll().
+     */
+    Statistics channelStatistics;
+
+    /**
+     * When the acquisition of the channel started, in milliseconds.
+     */
+    unsigned long channelStart;
+
+    /**
+     * The last rising edge of the out pin seen by poll(), in microseconds.
+     */
+    unsigned long channelEdge;
+
+    /**
+     * The timeout of each sample taken by poll(), in microseconds.
+     */
+    unsigned long pollTimeout;
+
+    /**
+     * The frequencies of the last complete frame.
+     */
+    long frameFrequencies[3];
 
 public:
 
@@ -115,12 +292,64 @@ public:
         RED_FILTER, GREEN_FILTER, BLUE_FILTER, CLEAR_FILTER
     };
 
+    /**
+     * Output frequency scaling enumeration.
+     */
+    enum Scaling {
+        POWER_DOWN, SCALING_2, SCALING_20, SCALING_100
+    };
+
+private:
+
+    /**
+     * The scaling of each filter.
+     */
+    Scaling scalings[3];
+
+    /**
+     * Whether the scaling of each filter is picked by the auto ranging.
+     */
+    bool autoRange;
+
+    /**
+     * The filter chain run on each frame.
+     */
+    ColorRecognitionFrameFilter* frameFilter;
+
+    /**
+     * The change detector run on each frame.
+     */
+    ColorRecognitionChangeDetector* changeDetector;
+
+#if COLOR_RECOGNITION_STATISTICS
+    /**
+     * The acquisition statistics.
+     */
+    ColorRecognitionStatistics driverStatistics;
+#endif
+
+public:
+
     /**
      * Private constructor.
      */
     ColorRecognitionTCS230PI(unsigned char outPin, unsigned char s2Pin,
             unsigned char s3Pin);
 
+    /**
+     * Constructor, with the scaling pins wired. If either of them is 
+     * NOT_WIRED, the scaling is fixed by the wiring as with the 3 pins 
+     * constructor.
+     * 
+     * @param outPin        The out pin.
+     * @param s2Pin         The s2 pin.
+     * @param s3Pin         The s3 pin.
+     * @param s0Pin         The s0 pin, or NOT_WIRED.
+     * @param s1Pin         The s1 pin, or NOT_WIRED.
+     */
+    ColorRecognitionTCS230PI(unsigned char outPin, unsigned char s2Pin,
+            unsigned char s3Pin, unsigned char s0Pin, unsigned char s1Pin);
+
     /**
      * Store the current read as the minimum frequency for each color.
      * 
@@ -135,6 +364,25 @@ public:
      */
     void adjustBlackBalance();
 
+    /**
+     * Saves the white and black balance, the scalings and the auto ranging
+     * flag to the EEPROM.
+     * 
+     * @param address       The EEPROM address of the record, which takes
+     *                      ColorRecognitionCalibration::getSize() bytes.
+     */
+    void saveCalibration(int address = 0);
+
+    /**
+     * Loads what saveCalibration() saved, so the sketch can skip the 
+     * interactive white and black balance at start up.
+     * 
+     * @param address       The EEPROM address of the record.
+     * @return              If a valid record was loaded. When not, nothing
+     *                      changes and the sensor must be calibrated.
+     */
+    bool loadCalibration(int address = 0);
+
     /**
      * Returns the red color intensity.
      * 
@@ -164,21 +412,222 @@ public:
     bool fillRGB(unsigned char buf[3]);
 
     /**
-     * Gets the frequency from the out pin.
+     * Measures the 16 bits red, green and blue intensities, according to the
+     * white balance.
+     * 
+     * @param buf           The buffer to fill.
+     * @return              Always true.
+     */
+    bool fillRGB16(unsigned int buf[3]);
+
+    /**
+     * Measures the red, green and blue frequencies, through the filter chain
+     * and the change detector like fillRGB().
+     * 
+     * @param buf           The buffer to fill.
+     * @return              Always true.
+     */
+    bool fillFrequencies(long buf[3]);
+
+    /**
+     * Starts the asynchronous acquisition of a frame.
+     * 
+     * The frame is acquired by successive calls to poll(), which take at most
+     * one sample each, so the caller keeps its cycle time.
+     * 
+     * The frame of a previous acquisition is dropped, so isReady() waits for
+     * the new one.
+     * 
+     * @param continuous    If true, a new frame is started as soon as one
+     *                      completes.
+     */
+    void start(bool continuous = false);
+
+    /**
+     * Stops the asynchronous acquisition.
+     */
+    void stop();
+
+    /**
+     * Advances the asynchronous acquisition by one sample. It blocks for at 
+     * most the poll timeout, which the waits for both edges of the sample 
+     * share.
+     * 
+     * The sample is the period ending at the next rising edge. When it is 
+     * called again before the following edge, the period starts at the edge
+     * the last call ended at, so a tight loop times the periods back to back.
+     * 
+     * @return              If a complete frame is available.
+     */
+    bool poll();
+
+    /**
+     * Returns if a complete frame is available.
+     * 
+     * @return              If a complete frame is available.
+     */
+    bool isReady();
+
+    /**
+     * Copies the color intensities of the last complete frame acquired by 
+     * poll(), and marks it as read.
+     * 
+     * @param buf           The buffer to fill.
+     * @return              If a complete frame was available.
+     */
+    bool readRGB(unsigned char buf[3]);
+
+    /**
+     * Sets the timeout of each sample taken by poll().
+     * 
+     * @param timeout       The timeout, in microseconds.
+     */
+    void setPollTimeout(unsigned long timeout);
+
+    /**
+     * Sets how long the out pin settles after each filter switch. The edges
+     * meanwhile are left out: getFrequency() waits, and poll() returns at 
+     * once.
+     * 
+     * One period of the slowest filter is enough: 2500us at the 2% scaling 
+     * for a 400Hz output.
+     * 
+     * @param settleTime    The settle time, in microseconds, 0 to time the 
+     *                      first edge.
+     */
+    void setSettleTime(unsigned long settleTime);
+
+    /**
+     * Sets the same output frequency scaling for all filters, and disables 
+     * the auto ranging.
+     * 
+     * It has no effect when the s0 and s1 pins are not wired.
+     * 
+     * @param scaling       The scaling.
+     */
+    void setScaling(Scaling scaling);
+
+    /**
+     * Returns the output frequency scaling of one filter. The clear filter 
+     * uses the scaling of the red one.
+     * 
+     * @param filter        The filter.
+     * @return              The scaling.
+     */
+    Scaling getScaling(Filter filter);
+
+    /**
+     * Enables the auto ranging.
+     * 
+     * After each measure, the scaling of the filter is moved to the highest 
+     * one that keeps the out pin under PERIOD_AUTO_RANGE_MAX_FREQUENCY. Low 
+     * light is then sampled at a higher frequency, which shortens the 
+     * measure, and bright light keeps the period resolution. It has no effect 
+     * when the s0 and s1 pins are not wired.
+     */
+    void enableAutoRange();
+
+    /**
+     * Disables the auto ranging, keeping the current scalings.
+     */
+    void disableAutoRange();
+
+    /**
+     * Sets the filter chain run on each frame, by fillRGB() and poll(), 
+     * between the acquisition and the conversion to intensities. The single
+     * channel getters are not filtered. The history of the chain is reset.
+     * 
+     * @param filter        The first filter of the chain, NULL for none.
+     */
+    void setFrameFilter(ColorRecognitionFrameFilter* filter);
+
+    /**
+     * Sets the change detector run on each frame by fillRGB() and poll(),
+     * after the filter chain. With the continuous poll() the sketch only
+     * checks hasChanged() or gets the callback, instead of converting every
+     * frame to intensities. The baseline of the detector is reset.
+     * 
+     * @param detector      The detector, NULL for none.
+     */
+    void setChangeDetector(ColorRecognitionChangeDetector* detector);
+
+    /**
+     * Enables the precision mode.
+     * 
+     * Instead of always taking the given number of samples, the frequency 
+     * measures keep the running mean and variance of the periods and stop as
+     * soon as the standard error of the mean falls under the precision, 
+     * relative to the mean. A stable signal is then measured with few 
+     * samples, and a noisy one with up to the maximum.
+     * 
+     * @param precision     The relative precision, e.g. 0.01 for 1%.
+     * @param minSamples    The minimum number of samples (at least 2).
+     * @param maxSamples    The maximum number of samples. The number of 
+     *                      samples asked for each measure is also a maximum.
+     */
+    void setPrecision(float precision, unsigned int minSamples = MIN_SAMPLES, unsigned int maxSamples = 255);
+
+    /**
+     * Disables the precision mode, so the measures take all the samples 
+     * asked for.
+     */
+    void disablePrecision();
+
+    /**
+     * Returns how many samples the last frequency measured used, by 
+     * getFrequency() or by poll() for its last channel.
+     * 
+     * @return              The number of samples.
+     */
+    unsigned int getSampleCount();
+
+#if COLOR_RECOGNITION_STATISTICS
+    /**
+     * Copies the acquisition statistics. The driver has no interrupts, so 
+     * the gate jitter and the interrupt times are left at their reset 
+     * values.
+     * 
+     * Only compiled when COLOR_RECOGNITION_STATISTICS is 1.
      * 
-     * NOTE: It uses pulseIn, collects some samples and calculate the frequency.
+     * @param statistics    The statistics to fill.
+     */
+    void getStatistics(ColorRecognitionStatistics* statistics);
+
+    /**
+     * Clears the acquisition statistics.
+     */
+    void resetStatistics();
+#endif
+
+    /**
+     * Gets the frequency from the out pin.
      * 
+     * NOTE: It polls the out pin and times whole periods, rising edge to 
+     * rising edge, back to back.
      * 
-     * The out pin generates a square wave, we sum the times between the raise 
-     * edge and divide by the number of samples.
+     * Each rising edge ends a period and starts the next one, so no period
+     * is skipped and the result does not depend on the duty cycle. The 
+     * periods are summed and divided once, so the frequency comes from the
+     * mean period, and the error of the edge timestamps does not add up 
+     * over the samples. A period over 1.5 times the mean of the samples 
+     * spans edges missed while the previous sample was worked on, and is 
+     * left out. When the period timed right after it is long as well, the 
+     * samples before were the short ones, and the measure starts over. The
+     * first edge that does not come within PERIOD_TIMEOUT ends the measure,
+     * and a dark pin reads 0. In the precision mode it may stop before the
+     * given number of samples.
      * 
      * <pre>
      *        1       2       3
      * ----   -----   -----   -----
      *    |   |   |   |   |   |
      *    -----   -----   -----
+     *        |<----->|<----->|
      * </pre>
      * 
+     * NOTE: It is the frequency of the pin, at the current scaling.
+     * 
+     * @param samples   The number of samples (up to 8000).
      * @return          The pin frequency.
      */
     long getFrequency(unsigned int samples);
@@ -186,6 +635,9 @@ public:
     /**
      * Sets the s2 and s3 pins according of the color passed as filter.
      * 
+     * The pins are only written, and the settle time restarted, when the 
+     * filter or its scaling change.
+     * 
      * <pre>
      * S2   S3  PHOTODIODE TYPE
      * L    L   Red
@@ -198,6 +650,111 @@ public:
      */
     void setFilter(Filter filter);
 
+private:
+
+    /**
+     * Measures one filter and normalizes the frequency to the 100% scaling. 
+     * With the auto ranging enabled, it measures again while the scaling of
+     * the filter moves.
+     * 
+     * @param filter        The filter.
+     * @param samples       The number of samples.
+     * @return              The frequency, in Hz, at the 100% scaling.
+     */
+    long measure(Filter filter, unsigned int samples);
+
+#if COLOR_RECOGNITION_STATISTICS
+    /**
+     * Counts a measure, and its saturation, in the statistics.
+     * 
+     * @param filter        The filter.
+     * @param frequency     The frequency, in Hz, at the 100% scaling.
+     */
+    void countMeasure(Filter filter, long frequency);
+#endif
+
+    /**
+     * Clears the statistics of a measure.
+     * 
+     * @param statistics    The statistics.
+     */
+    static void clearStatistics(Statistics* statistics);
+
+    /**
+     * Adds a period to the statistics of a measure.
+     * 
+     * @param statistics    The statistics.
+     * @param period        The period, in microseconds.
+     */
+    static void addSample(Statistics* statistics, unsigned long period);
+
+    /**
+     * Returns whether a period spans missed edges, being over 1.5 times the
+     * mean of the samples.
+     * 
+     * @param statistics    The statistics.
+     * @param period        The period, in microseconds.
+     * @return              If the period spans missed edges.
+     */
+    static bool spansMissedEdges(Statistics* statistics, unsigned long period);
+
+    /**
+     * Reads the out pin, from its input register when it is known.
+     * 
+     * @return              If the out pin is HIGH.
+     */
+    bool readOut();
+
+    /**
+     * Waits for the next rising edge of the out pin.
+     * 
+     * The clock is only read every 256 polls of the pin, so the edge is
+     * seen within a few cycles, and it is read once more when the edge 
+     * comes.
+     * 
+     * @param since         When the wait started, in microseconds.
+     * @param timeout       How long to wait, in microseconds.
+     * @param edge          Receives when the edge was seen, in 
+     *                      microseconds.
+     * @return              If the edge came before the timeout.
+     */
+    bool waitRisingEdge(unsigned long since, unsigned long timeout, unsigned long* edge);
+
+    /**
+     * Returns if the measure reached the precision, in the precision mode.
+     * 
+     * @param statistics    The statistics.
+     * @return              If the measure can stop.
+     */
+    bool isPrecise(Statistics* statistics);
+
+    /**
+     * Converts the statistics of a measure to frequency, and records its
+     * sample count.
+     * 
+     * @param statistics    The statistics.
+     * @return              The frequency, in Hz.
+     */
+    long toFrequency(Statistics* statistics);
+
+    /**
+     * Normalizes a frequency measured with a scaling to the 100% scaling.
+     * 
+     * @param frequency     The frequency, in Hz.
+     * @param scaling       The scaling it was measured with.
+     * @return              The frequency, in Hz, at the 100% scaling.
+     */
+    static long normalize(long frequency, Scaling scaling);
+
+    /**
+     * Moves the scaling of a filter according to the frequency measured at 
+     * its current scaling.
+     * 
+     * @param filter        The filter.
+     * @param frequency     The out pin frequency, in Hz.
+     * @return              If the scaling moved.
+     */
+    bool adjustRange(Filter filter, long frequency);
 };
 
 #endif /* __ARDUINO_DRIVER_COLOR_RECOGNITION_TCS230_PI_H__ */
@@ -0,0 +1,622 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * DriverBenchmark.cpp
+ * 
+ * Runs the drivers against simulated sensors on the host and reports, for
+ * each scenario, the acquisition rate, the latency of each frame, the
+ * interrupt load and the host CPU cycles the driver code takes per sample.
+ * 
+ * The rates and latencies are in virtual (target) time, so they are what a
+ * board would see. The cycles are host cycles, useful to compare drivers and
+ * changes against each other, not to predict AVR cycles.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#include <Arduino.h>
+#include <ArduinoSimulator.h>
+#include <ColorRecognitionTCS230.h>
+#include <ColorRecognitionTCS230PI.h>
+#include <ColorRecognitionTCS230IC.h>
+#include <ColorRecognitionTCS230Fast.h>
+#include <EEPROM.h>
+#include <ColorRecognitionStream.h>
+#include <ColorRecognitionColorSpace.h>
+#include <StreamDecoder.h>
+#include <stdio.h>
+
+/**
+ * How long each scenario runs, in virtual milliseconds.
+ */
+#define BENCHMARK_DURATION_IN_MS 10000
+
+/**
+ * The simulated sensor pins.
+ */
+#define OUT_PIN 2
+#define S2_PIN 3
+#define S3_PIN 4
+#define S0_PIN 5
+#define S1_PIN 6
+
+/**
+ * The compile-time pin driver, on the simulated sensor pins.
+ */
+typedef ColorRecognitionTCS230Fast<OUT_PIN, S2_PIN, S3_PIN> FastSensor;
+
+/**
+ * The pins of the sensors sharing OUT_PIN: S2, S3 and OE of each.
+ */
+#define SHARED_SENSORS 3
+#define SHARED_FIRST_PIN 22
+
+/**
+ * The colors converted by the color space benchmark, in batches.
+ */
+#define COLOR_SPACE_COLORS 32768
+#define COLOR_SPACE_BATCH 16
+
+/**
+ * The simulated photodiode frequencies at 100% scaling, in Hz. At the 2%
+ * scaling the drivers assume, they are 400Hz, 600Hz, 800Hz and 1800Hz.
+ */
+#define RED_FREQUENCY 20000.0
+#define GREEN_FREQUENCY 30000.0
+#define BLUE_FREQUENCY 40000.0
+#define CLEAR_FREQUENCY 90000.0
+
+/**
+ * The red frequency the light step scenario starts at, at 100% scaling. It
+ * drops to RED_FREQUENCY after the first period of the red measure.
+ */
+#define STEP_RED_FREQUENCY (4 * RED_FREQUENCY)
+
+struct BenchmarkResult {
+    unsigned long frames;
+    double seconds;
+    double latency;
+    unsigned long interrupts;
+    unsigned long samples;
+    uint64_t cycles;
+};
+
+static void printHeader() {
+    printf("%-26s %-22s %10s %12s %10s %14s\n", "driver", "scenario", "frames/s", "ms/frame", "ISR/s",
+            "cycles/sample");
+}
+
+static void printResult(const char* driver, const char* scenario, BenchmarkResult* result) {
+    printf("%-26s %-22s %10.2f %12.2f %10.0f %14.1f\n", driver, scenario, result->frames / result->seconds,
+            result->latency, result->interrupts / result->seconds,
+            result->samples == 0 ? 0.0 : (double) result->cycles / result->samples);
+}
+
+static void setUpSensor(double blue, bool scaling = false, unsigned char outPin = OUT_PIN) {
+    unsigned char sensor;
+    ArduinoSimulator::reset();
+    if (scaling) {
+        sensor = ArduinoSimulator::addSensor(outPin, S2_PIN, S3_PIN, S0_PIN, S1_PIN);
+    } else {
+        sensor = ArduinoSimulator::addSensor(outPin, S2_PIN, S3_PIN);
+    }
+    ArduinoSimulator::setFrequencies(sensor, RED_FREQUENCY, GREEN_FREQUENCY, blue, CLEAR_FREQUENCY);
+}
+
+static void benchmarkTCS230(const char* scenario, unsigned int gateTime, bool adaptive, bool autoRange = false,
+        ColorRecognitionTCS230::Schedule schedule = ColorRecognitionTCS230::RGB_SCHEDULE,
+        ColorRecognitionFrameFilter* filter = 0, unsigned int settleTime = 0) {
+    ColorRecognitionTCS230 tcs230;
+    ColorRecognitionFrame frames[FRAME_BUFFER_SIZE];
+    ColorRecognitionFrame first, last;
+    BenchmarkResult result;
+    unsigned long interrupts;
+    uint64_t cycles, end;
+    unsigned char n;
+
+    setUpSensor(BLUE_FREQUENCY, autoRange);
+    ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    tcs230.setGateTime(gateTime);
+    tcs230.setSchedule(schedule);
+    tcs230.setFrameFilter(filter);
+    tcs230.setSettleTime(settleTime);
+    if (adaptive) {
+        tcs230.enableAdaptiveGate();
+    }
+    if (autoRange) {
+        tcs230.initialize(OUT_PIN, S2_PIN, S3_PIN, S0_PIN, S1_PIN);
+        tcs230.enableAutoRange();
+    } else {
+        tcs230.initialize(OUT_PIN, S2_PIN, S3_PIN);
+    }
+    ArduinoSimulator::leave();
+
+    // Skips the first frame.
+    while (!tcs230.readFrame(&first) || first.sequence < 2) {
+        ArduinoSimulator::advance(1000);
+    }
+    interrupts = ArduinoSimulator::getExternalInterrupts() + ArduinoSimulator::getTimerInterrupts();
+    cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT);
+    result.samples = ArduinoSimulator::getExternalInterrupts();
+    end = ArduinoSimulator::getTime() + BENCHMARK_DURATION_IN_MS * 1000000ULL;
+    tcs230.drain(frames, FRAME_BUFFER_SIZE);
+    last = first;
+    while (ArduinoSimulator::getTime() < end) {
+        ArduinoSimulator::advance(1000);
+        ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+        n = tcs230.drain(frames, FRAME_BUFFER_SIZE);
+        ArduinoSimulator::leave();
+        if (n > 0) {
+            last = frames[n - 1];
+        }
+    }
+    result.frames = last.sequence - first.sequence;
+    result.seconds = BENCHMARK_DURATION_IN_MS / 1000.0;
+    result.latency = result.frames == 0 ? 0.0 : (last.timestamp - first.timestamp) / 1000.0 / result.frames;
+    result.interrupts = ArduinoSimulator::getExternalInterrupts() + ArduinoSimulator::getTimerInterrupts()
+            - interrupts;
+    result.samples = ArduinoSimulator::getExternalInterrupts() - result.samples;
+    result.cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT) - cycles;
+    printResult("ColorRecognitionTCS230", scenario, &result);
+    printf("%-26s %-22s red error: %.2f%%\n", "", "", (last.frequencies[0] - RED_FREQUENCY) * 100.0 / RED_FREQUENCY);
+}
+
+static void benchmarkShared(const char* scenario, unsigned int gateTime) {
+    ColorRecognitionTCS230 tcs230[SHARED_SENSORS];
+    ColorRecognitionFrame frames[FRAME_BUFFER_SIZE];
+    unsigned long sequences[SHARED_SENSORS];
+    BenchmarkResult result;
+    unsigned long interrupts;
+    uint64_t cycles, end;
+    unsigned char i, pin, sensor;
+
+    ArduinoSimulator::reset();
+    for (i = 0; i < SHARED_SENSORS; i++) {
+        pin = SHARED_FIRST_PIN + i * 3;
+        sensor = ArduinoSimulator::addSensor(OUT_PIN, pin, pin + 1, SIMULATOR_NOT_WIRED, SIMULATOR_NOT_WIRED,
+                pin + 2);
+        ArduinoSimulator::setFrequencies(sensor, RED_FREQUENCY, GREEN_FREQUENCY, BLUE_FREQUENCY, CLEAR_FREQUENCY);
+        tcs230[i].setGateTime(gateTime);
+        tcs230[i].setSchedule(ColorRecognitionTCS230::RGB_SCHEDULE);
+        tcs230[i].initializeShared(OUT_PIN, pin + 2, pin, pin + 1);
+    }
+
+    // Skips the first frame of each sensor.
+    for (i = 0; i < SHARED_SENSORS; i++) {
+        while (!tcs230[i].readFrame(&frames[0]) || frames[0].sequence < 2) {
+            ArduinoSimulator::advance(1000);
+        }
+    }
+    for (i = 0; i < SHARED_SENSORS; i++) {
+        tcs230[i].readFrame(&frames[0]);
+        sequences[i] = frames[0].sequence;
+        tcs230[i].drain(frames, FRAME_BUFFER_SIZE);
+    }
+    interrupts = ArduinoSimulator::getExternalInterrupts() + ArduinoSimulator::getTimerInterrupts();
+    cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT);
+    result.samples = ArduinoSimulator::getExternalInterrupts();
+    end = ArduinoSimulator::getTime() + BENCHMARK_DURATION_IN_MS * 1000000ULL;
+    while (ArduinoSimulator::getTime() < end) {
+        ArduinoSimulator::advance(1000);
+        ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+        for (i = 0; i < SHARED_SENSORS; i++) {
+            tcs230[i].drain(frames, FRAME_BUFFER_SIZE);
+        }
+        ArduinoSimulator::leave();
+    }
+    result.frames = 0;
+    for (i = 0; i < SHARED_SENSORS; i++) {
+        tcs230[i].readFrame(&frames[0]);
+        result.frames += frames[0].sequence - sequences[i];
+    }
+    result.seconds = BENCHMARK_DURATION_IN_MS / 1000.0;
+    result.latency = result.frames == 0 ? 0.0 : result.seconds * 1000.0 * SHARED_SENSORS / result.frames;
+    result.interrupts = ArduinoSimulator::getExternalInterrupts() + ArduinoSimulator::getTimerInterrupts()
+            - interrupts;
+    result.samples = ArduinoSimulator::getExternalInterrupts() - result.samples;
+    result.cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT) - cycles;
+    printResult("ColorRecognitionTCS230", scenario, &result);
+}
+
+static void benchmarkTCS230PI(const char* scenario, double blue, float precision = 0) {
+    ColorRecognitionTCS230PI tcs230(OUT_PIN, S2_PIN, S3_PIN);
+    unsigned char rgb[3];
+    BenchmarkResult result;
+    uint64_t start, cycles;
+
+    setUpSensor(blue);
+    if (precision > 0) {
+        tcs230.setPrecision(precision);
+    }
+    start = ArduinoSimulator::getTime();
+    result.frames = 0;
+    while (ArduinoSimulator::getTime() - start < BENCHMARK_DURATION_IN_MS * 1000000ULL) {
+        ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+        tcs230.fillRGB(rgb);
+        ArduinoSimulator::leave();
+        result.frames++;
+    }
+    cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT);
+    result.seconds = (ArduinoSimulator::getTime() - start) / 1e9;
+    result.latency = result.seconds * 1000.0 / result.frames;
+    result.interrupts = 0;
+    result.samples = ArduinoSimulator::getRisingReads();
+    result.cycles = cycles;
+    printResult("ColorRecognitionTCS230PI", scenario, &result);
+}
+
+static void benchmarkTCS230PIPoll(const char* scenario, double blue) {
+    ColorRecognitionTCS230PI tcs230(OUT_PIN, S2_PIN, S3_PIN);
+    unsigned char rgb[3];
+    BenchmarkResult result;
+    uint64_t start, before, longest = 0;
+
+    setUpSensor(blue);
+    start = ArduinoSimulator::getTime();
+    result.frames = 0;
+    tcs230.start(true);
+    while (ArduinoSimulator::getTime() - start < BENCHMARK_DURATION_IN_MS * 1000000ULL) {
+        before = ArduinoSimulator::getTime();
+        ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+        tcs230.poll();
+        if (tcs230.readRGB(rgb)) {
+            result.frames++;
+        }
+        ArduinoSimulator::leave();
+        if (ArduinoSimulator::getTime() - before > longest) {
+            longest = ArduinoSimulator::getTime() - before;
+        }
+    }
+    result.seconds = (ArduinoSimulator::getTime() - start) / 1e9;
+    result.latency = result.seconds * 1000.0 / result.frames;
+    result.interrupts = 0;
+    result.samples = ArduinoSimulator::getRisingReads();
+    result.cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT);
+    printResult("ColorRecognitionTCS230PI", scenario, &result);
+    printf("%-26s %-22s longest poll: %.2f ms\n", "", "", longest / 1e6);
+}
+
+static void benchmarkTCS230PIStep(const char* scenario) {
+    ColorRecognitionTCS230PI tcs230(OUT_PIN, S2_PIN, S3_PIN);
+    long frequencies[3];
+    uint64_t period;
+
+    setUpSensor(BLUE_FREQUENCY);
+    ArduinoSimulator::setFrequencies(0, STEP_RED_FREQUENCY, GREEN_FREQUENCY, BLUE_FREQUENCY, CLEAR_FREQUENCY);
+    // The out pin rises one period after the red filter is set, so the step
+    // comes half a period after the first period ends.
+    period = (uint64_t) (1e9 / (STEP_RED_FREQUENCY * 0.02));
+    ArduinoSimulator::scheduleFrequencies(ArduinoSimulator::getTime() + period * 5 / 2, 0, RED_FREQUENCY,
+            GREEN_FREQUENCY, BLUE_FREQUENCY, CLEAR_FREQUENCY);
+    ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    tcs230.fillFrequencies(frequencies);
+    ArduinoSimulator::leave();
+    printf("%-26s %-22s red error: %.2f%%\n", "ColorRecognitionTCS230PI", scenario,
+            (frequencies[0] - RED_FREQUENCY) * 100.0 / RED_FREQUENCY);
+}
+
+static void benchmarkTCS230IC(const char* scenario, double blue, unsigned char periods) {
+    ColorRecognitionTCS230IC* tcs230 = ColorRecognitionTCS230IC::getInstance();
+    unsigned int rgb[3];
+    long frequencies[3];
+    BenchmarkResult result;
+    unsigned long interrupts;
+    uint64_t cycles, start, end;
+    unsigned char frame;
+
+    setUpSensor(blue, false, ICP1_PIN);
+    ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    tcs230->initialize(S2_PIN, S3_PIN, periods);
+    ArduinoSimulator::leave();
+
+    // Skips the first frame.
+    frame = tcs230->getFrameCount();
+    while ((unsigned char) (tcs230->getFrameCount() - frame) < 2) {
+        ArduinoSimulator::advance(1000);
+    }
+    frame = tcs230->getFrameCount();
+    interrupts = ArduinoSimulator::getExternalInterrupts() + ArduinoSimulator::getTimerInterrupts();
+    cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT);
+    result.samples = ArduinoSimulator::getExternalInterrupts();
+    result.frames = 0;
+    start = ArduinoSimulator::getTime();
+    end = start + BENCHMARK_DURATION_IN_MS * 1000000ULL;
+    while (ArduinoSimulator::getTime() < end) {
+        ArduinoSimulator::advance(1000);
+        ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+        if (tcs230->getFrameCount() != frame) {
+            result.frames += (unsigned char) (tcs230->getFrameCount() - frame);
+            frame = tcs230->getFrameCount();
+            tcs230->fillRGB16(rgb);
+        }
+        ArduinoSimulator::leave();
+    }
+    tcs230->fillFrequencies(frequencies);
+    result.seconds = BENCHMARK_DURATION_IN_MS / 1000.0;
+    result.latency = result.frames == 0 ? 0.0 : result.seconds * 1000.0 / result.frames;
+    result.interrupts = ArduinoSimulator::getExternalInterrupts() + ArduinoSimulator::getTimerInterrupts()
+            - interrupts;
+    result.samples = ArduinoSimulator::getExternalInterrupts() - result.samples;
+    result.cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT) - cycles;
+    printResult("ColorRecognitionTCS230IC", scenario, &result);
+    printf("%-26s %-22s red error: %.2f%%\n", "", "", (frequencies[0] - RED_FREQUENCY) * 100.0 / RED_FREQUENCY);
+}
+
+static void benchmarkTCS230Fast(const char* scenario, unsigned int gateTime) {
+    FastSensor* tcs230 = FastSensor::getInstance();
+    unsigned int rgb[3];
+    long frequencies[3];
+    BenchmarkResult result;
+    unsigned long interrupts;
+    uint64_t cycles, start, end;
+    unsigned char frame;
+
+    setUpSensor(BLUE_FREQUENCY);
+    ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    tcs230->setGateTime(gateTime);
+    tcs230->initialize();
+    ArduinoSimulator::leave();
+
+    // Skips the first frame.
+    frame = tcs230->getFrameCount();
+    while ((unsigned char) (tcs230->getFrameCount() - frame) < 2) {
+        ArduinoSimulator::advance(1000);
+    }
+    frame = tcs230->getFrameCount();
+    interrupts = ArduinoSimulator::getExternalInterrupts() + ArduinoSimulator::getTimerInterrupts();
+    cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT);
+    result.samples = ArduinoSimulator::getExternalInterrupts();
+    result.frames = 0;
+    start = ArduinoSimulator::getTime();
+    end = start + BENCHMARK_DURATION_IN_MS * 1000000ULL;
+    while (ArduinoSimulator::getTime() < end) {
+        ArduinoSimulator::advance(1000);
+        ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+        if (tcs230->getFrameCount() != frame) {
+            result.frames += (unsigned char) (tcs230->getFrameCount() - frame);
+            frame = tcs230->getFrameCount();
+            tcs230->fillRGB16(rgb);
+        }
+        ArduinoSimulator::leave();
+    }
+    tcs230->fillFrequencies(frequencies);
+    result.seconds = BENCHMARK_DURATION_IN_MS / 1000.0;
+    result.latency = result.frames == 0 ? 0.0 : result.seconds * 1000.0 / result.frames;
+    result.interrupts = ArduinoSimulator::getExternalInterrupts() + ArduinoSimulator::getTimerInterrupts()
+            - interrupts;
+    result.samples = ArduinoSimulator::getExternalInterrupts() - result.samples;
+    result.cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT) - cycles;
+    printResult("ColorRecognitionTCS230Fast", scenario, &result);
+    printf("%-26s %-22s red error: %.2f%%\n", "", "", (frequencies[0] - RED_FREQUENCY) * 100.0 / RED_FREQUENCY);
+}
+
+/**
+ * The PC side of the simulated serial link.
+ */
+static StreamDecoder* streamDecoder;
+
+static void receiveStream(uint8_t value) {
+    StreamPacket packet;
+    streamDecoder->feed(value, &packet);
+}
+
+static void benchmarkStream(const char* scenario, unsigned long baud) {
+    ColorRecognitionTCS230 tcs230;
+    ColorRecognitionStream stream(&Serial);
+    ColorRecognitionFrame frames[FRAME_BUFFER_SIZE];
+    StreamDecoder decoder;
+    uint64_t end;
+    unsigned char n;
+
+    // 1ms gates, RGB only: 333 frames per second.
+    setUpSensor(BLUE_FREQUENCY);
+    streamDecoder = &decoder;
+    Serial.begin(baud);
+    Serial.receiver = receiveStream;
+    tcs230.setGateTime(1);
+    tcs230.setSchedule(ColorRecognitionTCS230::RGB_SCHEDULE);
+    tcs230.initialize(OUT_PIN, S2_PIN, S3_PIN);
+    end = ArduinoSimulator::getTime() + BENCHMARK_DURATION_IN_MS * 1000000ULL;
+    while (ArduinoSimulator::getTime() < end) {
+        n = tcs230.drain(frames, FRAME_BUFFER_SIZE);
+        stream.writeFrames(frames, n);
+        if (n == 0) {
+            ArduinoSimulator::advance(100);
+        }
+    }
+    printf("%-26s %-22s %10.2f %11.2f%% %10.0f\n", "ColorRecognitionStream", scenario,
+            decoder.packets * 1000.0 / BENCHMARK_DURATION_IN_MS, decoder.getLossRate() * 100.0,
+            Serial.bytes * 1000.0 / BENCHMARK_DURATION_IN_MS);
+}
+
+static void benchmarkStartUp() {
+    ColorRecognitionTCS230 tcs230;
+    uint64_t start, calibrate, save, load;
+
+    setUpSensor(BLUE_FREQUENCY);
+    tcs230.setGateTime(100);
+    tcs230.initialize(OUT_PIN, S2_PIN, S3_PIN);
+    start = ArduinoSimulator::getTime();
+    tcs230.adjustWhiteBalance();
+    calibrate = ArduinoSimulator::getTime() - start;
+    start = ArduinoSimulator::getTime();
+    tcs230.saveCalibration();
+    save = ArduinoSimulator::getTime() - start;
+
+    // A reset: a new instance, with the EEPROM kept.
+    ColorRecognitionTCS230 restarted;
+    setUpSensor(BLUE_FREQUENCY);
+    restarted.initialize(OUT_PIN, S2_PIN, S3_PIN);
+    start = ArduinoSimulator::getTime();
+    if (!restarted.loadCalibration()) {
+        printf("calibration record rejected\n");
+        return;
+    }
+    load = ArduinoSimulator::getTime() - start;
+    printf("start up: adjustWhiteBalance %.2f ms, saveCalibration %.2f ms (%u bytes), loadCalibration %.3f ms\n",
+            calibrate / 1e6, save / 1e6, ColorRecognitionCalibration::getSize(), load / 1e6);
+}
+
+/**
+ * The float reference of ColorRecognitionColorSpace::toHsv().
+ */
+static void referenceHsv(const unsigned char rgb[3], float hsv[3]) {
+    float r = rgb[0] / 255.0f, g = rgb[1] / 255.0f, b = rgb[2] / 255.0f;
+    float max = fmaxf(r, fmaxf(g, b)), min = fminf(r, fminf(g, b)), delta = max - min;
+    float hue = 0;
+    if (delta > 0) {
+        if (max == r) {
+            hue = fmodf((g - b) / delta + 6.0f, 6.0f);
+        } else if (max == g) {
+            hue = (b - r) / delta + 2.0f;
+        } else {
+            hue = (r - g) / delta + 4.0f;
+        }
+    }
+    hsv[0] = hue * 60.0f;
+    hsv[1] = max > 0 ? delta / max : 0;
+    hsv[2] = max;
+}
+
+static float referenceF(float t) {
+    return t > 216.0f / 24389.0f ? cbrtf(t) : t * (24389.0f / 27.0f) / 116.0f + 16.0f / 116.0f;
+}
+
+/**
+ * The float reference of ColorRecognitionColorSpace::toLab(), for linear 
+ * intensities.
+ */
+static void referenceLab(const unsigned char rgb[3], float lab[3]) {
+    float r = rgb[0] / 255.0f, g = rgb[1] / 255.0f, b = rgb[2] / 255.0f;
+    float x = (0.4124564f * r + 0.3575761f * g + 0.1804375f * b) / 0.95047f;
+    float y = 0.2126729f * r + 0.7151522f * g + 0.0721750f * b;
+    float z = (0.0193339f * r + 0.1191920f * g + 0.9503041f * b) / 1.08883f;
+    float fx = referenceF(x), fy = referenceF(y), fz = referenceF(z);
+    lab[0] = 116.0f * fy - 16.0f;
+    lab[1] = 500.0f * (fx - fy);
+    lab[2] = 200.0f * (fy - fz);
+}
+
+/**
+ * The colors the color space benchmark always converts, besides the random
+ * ones: the primaries, the secondaries and the colors between them.
+ */
+static const unsigned char saturatedColors[][3] = {
+    { 255, 0, 0 }, { 255, 255, 0 }, { 0, 255, 0 }, { 0, 255, 255 }, { 0, 0, 255 }, { 255, 0, 255 },
+    { 255, 0, 128 }, { 255, 128, 0 }, { 128, 255, 0 }, { 0, 255, 128 }, { 0, 128, 255 }, { 128, 0, 255 },
+    { 200, 10, 250 }, { 250, 240, 5 }
+};
+
+static void benchmarkColorSpace() {
+    static unsigned char rgb[COLOR_SPACE_COLORS][3];
+    static float reference[COLOR_SPACE_COLORS][3];
+    ColorRecognitionHsv hsv[COLOR_SPACE_BATCH];
+    ColorRecognitionLab lab[COLOR_SPACE_BATCH];
+    uint64_t cycles, hsvCycles, labCycles, hsvFloatCycles, labFloatCycles;
+    float error, hueError = 0, labError = 0;
+    unsigned int i, j;
+
+    srand(1);
+    for (i = 0; i < COLOR_SPACE_COLORS; i++) {
+        rgb[i][0] = rand() & 0xff;
+        rgb[i][1] = rand() & 0xff;
+        rgb[i][2] = rand() & 0xff;
+    }
+    // The saturated colors, whose channel differences of 128 or more 
+    // overflow a 16 bits int if scaled as signed.
+    for (i = 0; i < sizeof(saturatedColors) / sizeof(saturatedColors[0]); i++) {
+        rgb[i][0] = saturatedColors[i][0];
+        rgb[i][1] = saturatedColors[i][1];
+        rgb[i][2] = saturatedColors[i][2];
+    }
+
+    cycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT);
+    ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    for (i = 0; i < COLOR_SPACE_COLORS; i++) {
+        referenceHsv(rgb[i], reference[i]);
+    }
+    ArduinoSimulator::leave();
+    hsvFloatCycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT) - cycles;
+    cycles += hsvFloatCycles;
+    ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    for (i = 0; i < COLOR_SPACE_COLORS; i += COLOR_SPACE_BATCH) {
+        ColorRecognitionColorSpace::toHsv(&rgb[i], hsv, COLOR_SPACE_BATCH);
+        ArduinoSimulator::leave();
+        for (j = 0; j < COLOR_SPACE_BATCH; j++) {
+            error = fabsf(hsv[j].hue * 360.0f / COLOR_SPACE_HUE_STEPS - reference[i + j][0]);
+            if (reference[i + j][1] > 0 && fminf(error, 360.0f - error) > hueError) {
+                hueError = fminf(error, 360.0f - error);
+            }
+        }
+        ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    }
+    ArduinoSimulator::leave();
+    hsvCycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT) - cycles;
+    cycles += hsvCycles;
+
+    ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    for (i = 0; i < COLOR_SPACE_COLORS; i++) {
+        referenceLab(rgb[i], reference[i]);
+    }
+    ArduinoSimulator::leave();
+    labFloatCycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT) - cycles;
+    cycles += labFloatCycles;
+    ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    for (i = 0; i < COLOR_SPACE_COLORS; i += COLOR_SPACE_BATCH) {
+        ColorRecognitionColorSpace::toLab(&rgb[i], lab, COLOR_SPACE_BATCH);
+        ArduinoSimulator::leave();
+        for (j = 0; j < COLOR_SPACE_BATCH; j++) {
+            error = sqrtf(powf(lab[j].lightness - reference[i + j][0], 2) + powf(lab[j].a - reference[i + j][1], 2)
+                    + powf(lab[j].b - reference[i + j][2], 2));
+            if (error > labError) {
+                labError = error;
+            }
+        }
+        ArduinoSimulator::enter(ArduinoSimulator::DRIVER_ACCOUNT);
+    }
+    ArduinoSimulator::leave();
+    labCycles = ArduinoSimulator::getCycles(ArduinoSimulator::DRIVER_ACCOUNT) - cycles;
+
+    printf("%-26s %-22s %14s %14s %12s\n", "color space", "kernel", "cycles/color", "float cycles", "max error");
+    printf("%-26s %-22s %14.1f %14.1f %8.2f deg\n", "ColorRecognitionColorSpace", "toHsv",
+            (double) hsvCycles / COLOR_SPACE_COLORS, (double) hsvFloatCycles / COLOR_SPACE_COLORS, hueError);
+    printf("%-26s %-22s %14.1f %14.1f %9.2f dE\n", "ColorRecognitionColorSpace", "toLab",
+            (double) labCycles / COLOR_SPACE_COLORS, (double) labFloatCycles / COLOR_SPACE_COLORS, labError);
+}
+
+int main() {
+    ColorRecognitionSpikeFilter spike;
+    ColorRecognitionMedianFilter median;
+    ColorRecognitionIIRFilter iir;
+
+    spike.setNext(&median)->setNext(&iir);
+    printHeader();
+    benchmarkTCS230("gate 1000ms", 1000, false);
+    benchmarkTCS230("gate 100ms", 100, false);
+    benchmarkTCS230("gate 100ms, RGBC", 100, false, false, ColorRecognitionTCS230::RGBC_SCHEDULE);
+    benchmarkTCS230("gate 20ms", 20, false);
+    benchmarkTCS230("gate 20ms, filtered", 20, false, false, ColorRecognitionTCS230::RGB_SCHEDULE, &spike);
+    benchmarkTCS230("gate 10ms, auto range", 10, false, true);
+    benchmarkTCS230("gate 10ms, 1ms settle", 10, false, true, ColorRecognitionTCS230::RGB_SCHEDULE, 0, 1);
+    benchmarkTCS230("adaptive gate", 1000, true);
+    benchmarkTCS230("adaptive, auto range", 1000, true, true);
+    benchmarkShared("shared out, 3 x 20ms", 20);
+    benchmarkTCS230PI("fillRGB", BLUE_FREQUENCY);
+    benchmarkTCS230PI("fillRGB, 1% precision", BLUE_FREQUENCY, 0.01);
+    benchmarkTCS230PI("fillRGB, dark blue", 0.0);
+    benchmarkTCS230PIPoll("poll", BLUE_FREQUENCY);
+    benchmarkTCS230PIPoll("poll, dark blue", 0.0);
+    benchmarkTCS230PIStep("light step");
+    benchmarkTCS230IC("16 periods", BLUE_FREQUENCY, 16);
+    benchmarkTCS230IC("4 periods", BLUE_FREQUENCY, 4);
+    benchmarkTCS230IC("dark blue", 0.0, 16);
+    benchmarkTCS230Fast("gate 100ms", 100);
+    benchmarkTCS230Fast("gate 20ms", 20);
+    printf("%-26s %-22s %10s %12s %10s\n", "stream", "link", "frames/s", "lost", "bytes/s");
+    benchmarkStream("9600 baud", 9600);
+    benchmarkStream("115200 baud", 115200);
+    benchmarkStream("1000000 baud", 1000000);
+    benchmarkStartUp();
+    benchmarkColorSpace();
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * StreamDecoder.cpp
+ * 
+ * Decodes, on the PC, the packets written by ColorRecognitionStream.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#include "StreamDecoder.h"
+#include <ColorRecognitionCrc.h>
+
+StreamDecoder::StreamDecoder()
+        : length(0), overflow(false), synchronized(false), lastSequence(0), packets(0), crcErrors(0),
+          framingErrors(0), lostFrames(0) {
+}
+
+bool StreamDecoder::feed(uint8_t value, StreamPacket* packet) {
+    bool valid;
+    if (value != 0) {
+        if (length < sizeof(buffer)) {
+            buffer[length++] = value;
+        } else {
+            overflow = true;
+        }
+        return false;
+    }
+    if (length == 0 && !overflow) {
+        // Consecutive delimiters.
+        return false;
+    }
+    if (overflow) {
+        framingErrors++;
+        valid = false;
+    } else {
+        valid = decode(packet);
+    }
+    length = 0;
+    overflow = false;
+    if (!valid) {
+        return false;
+    }
+    if (synchronized && packet->sequence > lastSequence + 1) {
+        lostFrames += packet->sequence - lastSequence - 1;
+    }
+    synchronized = true;
+    lastSequence = packet->sequence;
+    packets++;
+    return true;
+}
+
+double StreamDecoder::getLossRate() const {
+    if (packets + lostFrames == 0) {
+        return 0.0;
+    }
+    return (double) lostFrames / (packets + lostFrames);
+}
+
+bool StreamDecoder::decode(StreamPacket* packet) {
+    uint8_t data[STREAM_PACKET_SIZE];
+    size_t in = 0, out = 0;
+    unsigned int crc = CRC_INITIAL_VALUE;
+    uint8_t code;
+    if (length != STREAM_PACKET_SIZE + 1) {
+        framingErrors++;
+        return false;
+    }
+    while (in < length) {
+        code = buffer[in++];
+        if (in + code - 1 > length) {
+            framingErrors++;
+            return false;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            data[out++] = buffer[in++];
+        }
+        if (in < length) {
+            data[out++] = 0;
+        }
+    }
+    if (out != STREAM_PACKET_SIZE) {
+        framingErrors++;
+        return false;
+    }
+    for (size_t i = 0; i < STREAM_PACKET_SIZE; i++) {
+        crc = ColorRecognitionCrc::update(crc, data[i]);
+    }
+    if (crc != 0 || data[0] != STREAM_VERSION) {
+        crcErrors++;
+        return false;
+    }
+    packet->flags = data[1];
+    packet->sequence = data[2] | (data[3] << 8) | (data[4] << 16) | ((uint32_t) data[5] << 24);
+    packet->timestamp = data[6] | (data[7] << 8) | (data[8] << 16) | ((uint32_t) data[9] << 24);
+    for (size_t i = 0; i < 4; i++) {
+        const uint8_t* field = &data[10 + i * 4];
+        packet->frequencies[i] = (int32_t) (field[0] | (field[1] << 8) | (field[2] << 16)
+                | ((uint32_t) field[3] << 24));
+    }
+    return true;
+}
@@ -0,0 +1,110 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * StreamDecoder.h
+ * 
+ * Decodes, on the PC, the packets written by ColorRecognitionStream. It is 
+ * plain C++, so it builds on any host.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_STREAM_DECODER_H__
+#define __ARDUINO_HOST_STREAM_DECODER_H__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ColorRecognitionStream.h>
+
+/**
+ * A decoded packet.
+ */
+struct StreamPacket {
+    uint8_t flags;
+    uint32_t sequence;
+    uint32_t timestamp;
+    int32_t frequencies[4];
+};
+
+class StreamDecoder {
+private:
+
+    /**
+     * The bytes received since the last delimiter.
+     */
+    uint8_t buffer[STREAM_ENCODED_SIZE];
+
+    /**
+     * How many bytes the buffer holds.
+     */
+    size_t length;
+
+    /**
+     * Whether more bytes than a packet were received since the last 
+     * delimiter.
+     */
+    bool overflow;
+
+    /**
+     * Whether a packet was decoded, so the last sequence is known.
+     */
+    bool synchronized;
+
+    /**
+     * The sequence of the last packet.
+     */
+    uint32_t lastSequence;
+
+public:
+
+    /**
+     * The valid packets.
+     */
+    unsigned long packets;
+
+    /**
+     * The packets rejected by the CRC or the version.
+     */
+    unsigned long crcErrors;
+
+    /**
+     * The packets with a wrong size or a wrong COBS encoding.
+     */
+    unsigned long framingErrors;
+
+    /**
+     * The frames missing from the sequence, dropped by the driver or lost on
+     * the link.
+     */
+    unsigned long lostFrames;
+
+    StreamDecoder();
+
+    /**
+     * Takes one received byte.
+     * 
+     * @param value         The byte.
+     * @param packet        Filled when a packet is complete.
+     * @return              If a valid packet was completed.
+     */
+    bool feed(uint8_t value, StreamPacket* packet);
+
+    /**
+     * Returns the fraction of the frames that were lost.
+     * 
+     * @return              The loss rate, from 0 to 1.
+     */
+    double getLossRate() const;
+
+private:
+
+    /**
+     * Decodes the buffer.
+     * 
+     * @param packet        The packet to fill.
+     * @return              If the packet is valid.
+     */
+    bool decode(StreamPacket* packet);
+};
+
+#endif /* __ARDUINO_HOST_STREAM_DECODER_H__ */
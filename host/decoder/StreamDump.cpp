@@ -0,0 +1,35 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * StreamDump.cpp
+ * 
+ * Reads the packets written by ColorRecognitionStream from the standard
+ * input (for example a serial port set up with stty) and prints them as CSV.
+ * The counters of the decoder are printed to the standard error at the end.
+ * 
+ *     stty -F /dev/ttyUSB0 115200 raw && build/host/stream-dump < /dev/ttyUSB0
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#include "StreamDecoder.h"
+#include <stdio.h>
+
+int main() {
+    StreamDecoder decoder;
+    StreamPacket packet;
+    int c;
+
+    printf("sequence,timestamp,flags,red,green,blue,clear\n");
+    while ((c = getchar()) != EOF) {
+        if (decoder.feed((uint8_t) c, &packet)) {
+            printf("%lu,%lu,%u,%ld,%ld,%ld,%ld\n", (unsigned long) packet.sequence,
+                    (unsigned long) packet.timestamp, packet.flags, (long) packet.frequencies[0],
+                    (long) packet.frequencies[1], (long) packet.frequencies[2], (long) packet.frequencies[3]);
+        }
+    }
+    fprintf(stderr, "packets: %lu, lost frames: %lu (%.2f%%), CRC errors: %lu, framing errors: %lu\n",
+            decoder.packets, decoder.lostFrames, decoder.getLossRate() * 100.0, decoder.crcErrors,
+            decoder.framingErrors);
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * Arduino.h
+ * 
+ * Host-side replacement for the Arduino core. It only declares what the
+ * drivers use; the behavior is provided by the ArduinoSimulator, which keeps
+ * a virtual clock and drives simulated TCS230 sensors.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_ARDUINO_H__
+#define __ARDUINO_HOST_ARDUINO_H__ 1
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <HardwareSerial.h>
+
+#define HIGH                0x1
+#define LOW                 0x0
+
+#define INPUT               0x0
+#define OUTPUT              0x1
+#define INPUT_PULLUP        0x2
+
+#define CHANGE              1
+#define FALLING             2
+#define RISING              3
+
+#define NOT_AN_INTERRUPT    -1
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+
+/**
+ * The words are read by their bytes, as on the AVR, so they also read the low
+ * half of the 32 bits int tables of the host.
+ */
+static inline uint16_t pgm_read_word(const void* address) {
+    uint16_t value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+static inline uint32_t pgm_read_dword(const void* address) {
+    uint32_t value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+#define NOT_A_PIN           0
+
+/**
+ * The pins are grouped in ports of 8 bits, numbered from 1. The simulator
+ * watches the output registers, so the writes to them drive the simulated
+ * sensors like digitalWrite().
+ */
+#define SIMULATED_PORTS     10
+#define digitalPinToPort(p) ((p) < 8 * (SIMULATED_PORTS - 1) ? (p) / 8 + 1 : NOT_A_PIN)
+#define digitalPinToBitMask(p) (1 << ((p) % 8))
+#define portOutputRegister(port) (&simulatedPorts[port])
+
+extern volatile uint8_t simulatedPorts[SIMULATED_PORTS];
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+/**
+ * External interrupt lines, numbered as on the Arduino Mega.
+ */
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : ((p) >= 18 && (p) <= 21 ? 23 - (p) : NOT_AN_INTERRUPT)))
+
+void pinMode(uint8_t pin, uint8_t mode);
+
+void digitalWrite(uint8_t pin, uint8_t value);
+
+int digitalRead(uint8_t pin);
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+
+void attachInterrupt(uint8_t interruptNumber, void (*isr)(void), int mode);
+
+void detachInterrupt(uint8_t interruptNumber);
+
+void interrupts();
+
+void noInterrupts();
+
+unsigned long millis();
+
+unsigned long micros();
+
+void delay(unsigned long ms);
+
+void delayMicroseconds(unsigned int us);
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+#endif /* __ARDUINO_HOST_ARDUINO_H__ */
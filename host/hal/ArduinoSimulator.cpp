@@ -0,0 +1,715 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ArduinoSimulator.cpp
+ * 
+ * Virtual clock and simulated TCS230 sensors behind the host Arduino HAL.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_ARDUINO_SIMULATOR_CPP__
+#define __ARDUINO_HOST_ARDUINO_SIMULATOR_CPP__ 1
+
+#include "ArduinoSimulator.h"
+#include <Arduino.h>
+#include <TimerOne.h>
+#include <EEPROM.h>
+#include <avr/io.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#define NEVER                       UINT64_MAX
+#define TIMER_SOURCE                -1
+#define OVERFLOW_SOURCE             -2
+#define CAPTURE_SOURCE              -3
+#define EXTERNAL_INTERRUPTS         6
+#define TIMER_ONE_MAX_PERIOD        8388480L
+#define ACCOUNT_STACK_DEPTH         16
+#define EEPROM_WRITE_TIME_IN_US     3300
+#define CAPTURE_OVERFLOW_TIME       (65536ULL * 1000000000ULL / F_CPU)
+
+struct SimulatedSensor {
+    unsigned char outPin;
+    unsigned char s0Pin;
+    unsigned char s1Pin;
+    unsigned char s2Pin;
+    unsigned char s3Pin;
+    unsigned char oePin;
+    double frequencies[4];
+    bool active;
+    uint64_t start;
+    uint64_t period;
+};
+
+struct SimulatedInterrupt {
+    void (*isr)(void);
+    int mode;
+    uint64_t last;
+};
+
+static const unsigned char interruptPins[EXTERNAL_INTERRUPTS] = { 2, 3, 21, 20, 19, 18 };
+
+static uint64_t now = 0;
+static uint64_t callCost = 1000;
+static bool inInterrupt = false;
+static unsigned char pinLevels[SIMULATOR_PINS];
+static uint8_t portLevels[SIMULATED_PORTS];
+static SimulatedSensor sensors[SIMULATOR_MAX_SENSORS];
+static unsigned char sensorCount = 0;
+static SimulatedInterrupt externalInterrupts[EXTERNAL_INTERRUPTS];
+static uint64_t timerNext = NEVER;
+static unsigned long externalInterruptCount = 0;
+static unsigned long timerInterruptCount = 0;
+static unsigned long pulseInCount = 0;
+static unsigned char lastReads[SIMULATOR_PINS];
+static unsigned long risingReadCount = 0;
+static ArduinoSimulator::Account accountStack[ACCOUNT_STACK_DEPTH];
+static unsigned char accountDepth = 0;
+static uint64_t accountCycles[3];
+static uint64_t accountSince = 0;
+static uint64_t changeAt = NEVER;
+static unsigned char changeSensor = 0;
+static double changeFrequencies[4];
+static uint64_t captureStart = NEVER;
+static uint64_t captureLast = 0;
+static uint64_t captureOverflow = NEVER;
+
+volatile uint8_t simulatedPorts[SIMULATED_PORTS];
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint8_t TIFR1;
+volatile uint8_t TIMSK1;
+volatile uint16_t TCNT1;
+volatile uint16_t ICR1;
+
+TimerOne Timer1;
+
+/**
+ * The Timer1 vectors of the input capture driver, when it is linked.
+ */
+void TIMER1_CAPT_vect() __attribute__((weak));
+void TIMER1_OVF_vect() __attribute__((weak));
+
+EEPROMClass EEPROM;
+
+HardwareSerial Serial;
+
+/**
+ * Charges the HAL account while in scope.
+ */
+class HalScope {
+public:
+
+    HalScope() {
+        ArduinoSimulator::enter(ArduinoSimulator::HAL_ACCOUNT);
+    }
+
+    ~HalScope() {
+        ArduinoSimulator::leave();
+    }
+};
+
+static uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+static void charge() {
+    uint64_t cycles = readCycles();
+    accountCycles[accountStack[accountDepth]] += cycles - accountSince;
+    accountSince = cycles;
+}
+
+static unsigned char wiredLevel(unsigned char pin, unsigned char unwired) {
+    if (pin == SIMULATOR_NOT_WIRED) {
+        return unwired;
+    }
+    return pinLevels[pin];
+}
+
+static void configure(SimulatedSensor *sensor) {
+    unsigned char s0, s1, s2, s3;
+    double scaling, frequency;
+    if (sensor->s0Pin == SIMULATOR_NOT_WIRED && sensor->s1Pin == SIMULATOR_NOT_WIRED) {
+        s0 = LOW;
+        s1 = HIGH;
+    } else {
+        s0 = wiredLevel(sensor->s0Pin, LOW);
+        s1 = wiredLevel(sensor->s1Pin, LOW);
+    }
+    s2 = wiredLevel(sensor->s2Pin, LOW);
+    s3 = wiredLevel(sensor->s3Pin, LOW);
+    scaling = (s0 == HIGH) ? ((s1 == HIGH) ? 1.0 : 0.2) : ((s1 == HIGH) ? 0.02 : 0.0);
+    if (s2 == LOW) {
+        frequency = sensor->frequencies[(s3 == LOW) ? ArduinoSimulator::RED_PHOTODIODE : ArduinoSimulator::BLUE_PHOTODIODE];
+    } else {
+        frequency = sensor->frequencies[(s3 == LOW) ? ArduinoSimulator::CLEAR_PHOTODIODE : ArduinoSimulator::GREEN_PHOTODIODE];
+    }
+    frequency *= scaling;
+    sensor->active = frequency > 0.0 && wiredLevel(sensor->oePin, LOW) == LOW;
+    if (sensor->active) {
+        sensor->period = (uint64_t) (1e12 / frequency + 0.5);
+        sensor->start = now * 1000 + sensor->period + 1000000;
+    }
+}
+
+/**
+ * Applies the writes to the output registers since the last call.
+ */
+static void syncPorts();
+
+/**
+ * Starts or stops the Timer1 input capture from its registers, which the
+ * driver writes directly: the timer starts counting at the first sync 
+ * after it is clocked.
+ */
+static void syncCapture() {
+    // The flags are cleared by writing ones to them on the board. As the 
+    // interrupts are dispatched in order, none is ever left pending here.
+    TIFR1 = 0;
+    if ((TCCR1B & _BV(CS10)) == 0 || (TIMSK1 & (_BV(ICIE1) | _BV(TOIE1))) == 0) {
+        captureStart = NEVER;
+        captureOverflow = NEVER;
+    } else if (captureStart == NEVER) {
+        captureStart = now;
+        captureLast = now;
+        captureOverflow = now + CAPTURE_OVERFLOW_TIME;
+    }
+}
+
+static void syncPorts() {
+    unsigned char pin;
+    for (unsigned char port = 1; port < SIMULATED_PORTS; port++) {
+        if (simulatedPorts[port] == portLevels[port]) {
+            continue;
+        }
+        for (unsigned char bit = 0; bit < 8; bit++) {
+            pin = (port - 1) * 8 + bit;
+            if (pin < SIMULATOR_PINS) {
+                ArduinoSimulator::pinWritten(pin, (simulatedPorts[port] >> bit) & 1);
+            }
+        }
+        portLevels[port] = simulatedPorts[port];
+    }
+}
+
+static SimulatedSensor *lineDriver(unsigned char pin) {
+    for (unsigned char i = 0; i < sensorCount; i++) {
+        if (sensors[i].outPin == pin && sensors[i].active) {
+            return &sensors[i];
+        }
+    }
+    return 0;
+}
+
+static uint64_t nextEdge(SimulatedSensor *sensor, uint64_t after, bool rising) {
+    uint64_t base, edge, picoseconds = after * 1000;
+    if (sensor == 0) {
+        return NEVER;
+    }
+    base = sensor->start + (rising ? 0 : sensor->period / 2);
+    if (picoseconds < base) {
+        edge = base;
+    } else {
+        edge = base + ((picoseconds - base) / sensor->period + 1) * sensor->period;
+    }
+    edge = (edge + 999) / 1000;
+    return (edge > after) ? edge : after + 1;
+}
+
+static unsigned char lineLevel(unsigned char pin, uint64_t t) {
+    SimulatedSensor *sensor = lineDriver(pin);
+    uint64_t picoseconds = t * 1000;
+    if (sensor == 0 || picoseconds < sensor->start) {
+        return LOW;
+    }
+    return (((picoseconds - sensor->start) % sensor->period) < sensor->period / 2) ? HIGH : LOW;
+}
+
+static uint64_t nextInterruptEdge(unsigned char i) {
+    SimulatedInterrupt *interrupt = &externalInterrupts[i];
+    SimulatedSensor *sensor;
+    uint64_t rising, falling;
+    if (interrupt->isr == 0) {
+        return NEVER;
+    }
+    sensor = lineDriver(interruptPins[i]);
+    rising = (interrupt->mode == FALLING) ? NEVER : nextEdge(sensor, interrupt->last, true);
+    falling = (interrupt->mode == RISING) ? NEVER : nextEdge(sensor, interrupt->last, false);
+    return (rising < falling) ? rising : falling;
+}
+
+void ArduinoSimulator::reset() {
+    now = 0;
+    callCost = 1000;
+    inInterrupt = false;
+    memset(pinLevels, 0, sizeof(pinLevels));
+    memset(portLevels, 0, sizeof(portLevels));
+    for (unsigned char i = 0; i < SIMULATED_PORTS; i++) {
+        simulatedPorts[i] = 0;
+    }
+    memset(sensors, 0, sizeof(sensors));
+    sensorCount = 0;
+    memset(externalInterrupts, 0, sizeof(externalInterrupts));
+    timerNext = NEVER;
+    externalInterruptCount = 0;
+    timerInterruptCount = 0;
+    pulseInCount = 0;
+    memset(lastReads, 0, sizeof(lastReads));
+    risingReadCount = 0;
+    changeAt = NEVER;
+    TCCR1A = 0;
+    TCCR1B = 0;
+    TIFR1 = 0;
+    TIMSK1 = 0;
+    captureStart = NEVER;
+    captureOverflow = NEVER;
+    accountDepth = 0;
+    accountStack[0] = HOST_ACCOUNT;
+    memset(accountCycles, 0, sizeof(accountCycles));
+    accountSince = readCycles();
+    Timer1 = TimerOne();
+    Serial = HardwareSerial();
+}
+
+unsigned char ArduinoSimulator::addSensor(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin,
+        unsigned char s0Pin, unsigned char s1Pin, unsigned char oePin) {
+    SimulatedSensor *sensor = &sensors[sensorCount];
+    sensor->outPin = outPin;
+    sensor->s0Pin = s0Pin;
+    sensor->s1Pin = s1Pin;
+    sensor->s2Pin = s2Pin;
+    sensor->s3Pin = s3Pin;
+    sensor->oePin = oePin;
+    configure(sensor);
+    return sensorCount++;
+}
+
+void ArduinoSimulator::setFrequencies(unsigned char sensor, double red, double green, double blue, double clear) {
+    sensors[sensor].frequencies[RED_PHOTODIODE] = red;
+    sensors[sensor].frequencies[GREEN_PHOTODIODE] = green;
+    sensors[sensor].frequencies[BLUE_PHOTODIODE] = blue;
+    sensors[sensor].frequencies[CLEAR_PHOTODIODE] = clear;
+    configure(&sensors[sensor]);
+}
+
+void ArduinoSimulator::scheduleFrequencies(uint64_t nanoseconds, unsigned char sensor, double red, double green,
+        double blue, double clear) {
+    changeAt = nanoseconds;
+    changeSensor = sensor;
+    changeFrequencies[RED_PHOTODIODE] = red;
+    changeFrequencies[GREEN_PHOTODIODE] = green;
+    changeFrequencies[BLUE_PHOTODIODE] = blue;
+    changeFrequencies[CLEAR_PHOTODIODE] = clear;
+}
+
+void ArduinoSimulator::setCallCost(unsigned long nanoseconds) {
+    callCost = nanoseconds;
+}
+
+void ArduinoSimulator::advance(unsigned long microseconds) {
+    advanceTo(now + (uint64_t) microseconds * 1000);
+}
+
+void ArduinoSimulator::advanceTo(uint64_t nanoseconds) {
+    HalScope scope;
+    uint64_t next, edge;
+    int source;
+    if (inInterrupt) {
+        if (nanoseconds > now) {
+            now = nanoseconds;
+        }
+        return;
+    }
+    syncPorts();
+    syncCapture();
+    while (true) {
+        next = timerNext;
+        source = TIMER_SOURCE;
+        for (unsigned char i = 0; i < EXTERNAL_INTERRUPTS; i++) {
+            edge = nextInterruptEdge(i);
+            if (edge < next) {
+                next = edge;
+                source = i;
+            }
+        }
+        if ((TIMSK1 & _BV(TOIE1)) && captureOverflow <= next) {
+            next = captureOverflow;
+            source = OVERFLOW_SOURCE;
+        }
+        if ((TIMSK1 & _BV(ICIE1)) && captureStart != NEVER) {
+            edge = nextEdge(lineDriver(SIMULATOR_ICP1_PIN), captureLast, true);
+            if (edge < next) {
+                next = edge;
+                source = CAPTURE_SOURCE;
+            }
+        }
+        if (changeAt <= next && changeAt <= nanoseconds) {
+            // The frequencies change before the interrupts that follow.
+            if (changeAt > now) {
+                now = changeAt;
+            }
+            changeAt = NEVER;
+            setFrequencies(changeSensor, changeFrequencies[RED_PHOTODIODE], changeFrequencies[GREEN_PHOTODIODE],
+                    changeFrequencies[BLUE_PHOTODIODE], changeFrequencies[CLEAR_PHOTODIODE]);
+            continue;
+        }
+        if (next > nanoseconds) {
+            break;
+        }
+        if (next > now) {
+            now = next;
+        }
+        inInterrupt = true;
+        enter(DRIVER_ACCOUNT);
+        if (source == TIMER_SOURCE) {
+            timerNext = now + Timer1.period * 1000;
+            timerInterruptCount++;
+            Timer1.isrCallback();
+        } else if (source == OVERFLOW_SOURCE) {
+            captureOverflow += CAPTURE_OVERFLOW_TIME;
+            timerInterruptCount++;
+            TIMER1_OVF_vect();
+        } else if (source == CAPTURE_SOURCE) {
+            captureLast = now;
+            ICR1 = (uint16_t) ((now - captureStart) * (F_CPU / 1000000L) / 1000);
+            externalInterruptCount++;
+            TIMER1_CAPT_vect();
+        } else {
+            externalInterrupts[source].last = now;
+            externalInterruptCount++;
+            externalInterrupts[source].isr();
+        }
+        leave();
+        inInterrupt = false;
+        syncPorts();
+        syncCapture();
+    }
+    if (nanoseconds > now) {
+        now = nanoseconds;
+    }
+}
+
+uint64_t ArduinoSimulator::getTime() {
+    return now;
+}
+
+unsigned char ArduinoSimulator::getLevel(unsigned char pin) {
+    for (unsigned char i = 0; i < sensorCount; i++) {
+        if (sensors[i].outPin == pin) {
+            return lineLevel(pin, now);
+        }
+    }
+    return pinLevels[pin];
+}
+
+uint64_t ArduinoSimulator::getNextTransition(unsigned char pin, unsigned char level) {
+    if (getLevel(pin) == level) {
+        return now;
+    }
+    return nextEdge(lineDriver(pin), now, level == HIGH);
+}
+
+unsigned long ArduinoSimulator::getExternalInterrupts() {
+    return externalInterruptCount;
+}
+
+unsigned long ArduinoSimulator::getTimerInterrupts() {
+    return timerInterruptCount;
+}
+
+unsigned long ArduinoSimulator::getPulseInCalls() {
+    return pulseInCount;
+}
+
+unsigned long ArduinoSimulator::getRisingReads() {
+    return risingReadCount;
+}
+
+void ArduinoSimulator::enter(Account account) {
+    charge();
+    if (accountDepth < ACCOUNT_STACK_DEPTH - 1) {
+        accountStack[++accountDepth] = account;
+    }
+}
+
+void ArduinoSimulator::leave() {
+    charge();
+    if (accountDepth > 0) {
+        accountDepth--;
+    }
+}
+
+uint64_t ArduinoSimulator::getCycles(Account account) {
+    charge();
+    return accountCycles[account];
+}
+
+bool ArduinoSimulator::isInInterrupt() {
+    return inInterrupt;
+}
+
+void ArduinoSimulator::chargeCall() {
+    if (!inInterrupt) {
+        advanceTo(now + callCost);
+    }
+}
+
+void ArduinoSimulator::pinWritten(unsigned char pin, unsigned char value) {
+    unsigned char port = digitalPinToPort(pin);
+    if (pin >= SIMULATOR_PINS || pinLevels[pin] == value) {
+        return;
+    }
+    pinLevels[pin] = value;
+    if (port != NOT_A_PIN) {
+        // Only the bit of the pin, the others may hold writes not synced yet.
+        if (value == HIGH) {
+            simulatedPorts[port] |= digitalPinToBitMask(pin);
+            portLevels[port] |= digitalPinToBitMask(pin);
+        } else {
+            simulatedPorts[port] &= ~digitalPinToBitMask(pin);
+            portLevels[port] &= ~digitalPinToBitMask(pin);
+        }
+    }
+    for (unsigned char i = 0; i < sensorCount; i++) {
+        SimulatedSensor *sensor = &sensors[i];
+        if (pin == sensor->s0Pin || pin == sensor->s1Pin || pin == sensor->s2Pin || pin == sensor->s3Pin
+                || pin == sensor->oePin) {
+            configure(sensor);
+        }
+    }
+}
+
+void ArduinoSimulator::setInterrupt(unsigned char interruptNumber, void (*isr)(void), int mode) {
+    if (interruptNumber >= EXTERNAL_INTERRUPTS) {
+        return;
+    }
+    externalInterrupts[interruptNumber].isr = isr;
+    externalInterrupts[interruptNumber].mode = mode;
+    externalInterrupts[interruptNumber].last = now;
+}
+
+void ArduinoSimulator::timerChanged() {
+    if (Timer1.running && Timer1.isrCallback != 0) {
+        timerNext = now + Timer1.period * 1000;
+    } else {
+        timerNext = NEVER;
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void) pin;
+    (void) mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    HalScope scope;
+    ArduinoSimulator::pinWritten(pin, value ? HIGH : LOW);
+}
+
+int digitalRead(uint8_t pin) {
+    HalScope scope;
+    unsigned char level;
+    ArduinoSimulator::chargeCall();
+    level = ArduinoSimulator::getLevel(pin);
+    if (pin < SIMULATOR_PINS) {
+        if (level == HIGH && lastReads[pin] == LOW) {
+            risingReadCount++;
+        }
+        lastReads[pin] = level;
+    }
+    return level;
+}
+
+static bool waitLevel(uint8_t pin, uint8_t level, uint64_t deadline) {
+    uint64_t t;
+    while (ArduinoSimulator::getLevel(pin) != level) {
+        t = ArduinoSimulator::getNextTransition(pin, level);
+        if (t > deadline) {
+            ArduinoSimulator::advanceTo(deadline);
+            return false;
+        }
+        ArduinoSimulator::advanceTo(t);
+    }
+    return true;
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout) {
+    HalScope scope;
+    uint64_t deadline = ArduinoSimulator::getTime() + (uint64_t) timeout * 1000;
+    uint64_t begin;
+    pulseInCount++;
+    if (!waitLevel(pin, !state, deadline) || !waitLevel(pin, state, deadline)) {
+        return 0;
+    }
+    begin = ArduinoSimulator::getTime();
+    if (!waitLevel(pin, !state, deadline)) {
+        return 0;
+    }
+    return (unsigned long) ((ArduinoSimulator::getTime() - begin) / 1000);
+}
+
+void attachInterrupt(uint8_t interruptNumber, void (*isr)(void), int mode) {
+    HalScope scope;
+    ArduinoSimulator::setInterrupt(interruptNumber, isr, mode);
+}
+
+void detachInterrupt(uint8_t interruptNumber) {
+    HalScope scope;
+    ArduinoSimulator::setInterrupt(interruptNumber, 0, 0);
+}
+
+void interrupts() {
+}
+
+void noInterrupts() {
+}
+
+unsigned long millis() {
+    HalScope scope;
+    ArduinoSimulator::chargeCall();
+    return (unsigned long) (ArduinoSimulator::getTime() / 1000000);
+}
+
+unsigned long micros() {
+    HalScope scope;
+    ArduinoSimulator::chargeCall();
+    return (unsigned long) (ArduinoSimulator::getTime() / 1000);
+}
+
+void delay(unsigned long ms) {
+    HalScope scope;
+    ArduinoSimulator::advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    HalScope scope;
+    ArduinoSimulator::advance(us);
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+void TimerOne::initialize(long microseconds) {
+    HalScope scope;
+    running = true;
+    setPeriod(microseconds);
+}
+
+void TimerOne::setPeriod(long microseconds) {
+    HalScope scope;
+    if (microseconds > TIMER_ONE_MAX_PERIOD) {
+        microseconds = TIMER_ONE_MAX_PERIOD;
+    }
+    if (microseconds < 1) {
+        microseconds = 1;
+    }
+    period = microseconds;
+    ArduinoSimulator::timerChanged();
+}
+
+void TimerOne::attachInterrupt(void (*isr)(), long microseconds) {
+    HalScope scope;
+    isrCallback = isr;
+    if (microseconds > 0) {
+        setPeriod(microseconds);
+    } else {
+        ArduinoSimulator::timerChanged();
+    }
+}
+
+void TimerOne::detachInterrupt() {
+    HalScope scope;
+    isrCallback = 0;
+    ArduinoSimulator::timerChanged();
+}
+
+void TimerOne::start() {
+    HalScope scope;
+    running = true;
+    ArduinoSimulator::timerChanged();
+}
+
+void TimerOne::stop() {
+    HalScope scope;
+    running = false;
+    ArduinoSimulator::timerChanged();
+}
+
+void TimerOne::restart() {
+    start();
+}
+
+void TimerOne::resume() {
+    start();
+}
+
+EEPROMClass::EEPROMClass()
+        : writes(0) {
+    for (unsigned int i = 0; i < EEPROM_SIZE; i++) {
+        data[i] = 0xff;
+    }
+}
+
+unsigned char EEPROMClass::read(int address) {
+    HalScope scope;
+    return data[address % EEPROM_SIZE];
+}
+
+void EEPROMClass::write(int address, unsigned char value) {
+    HalScope scope;
+    data[address % EEPROM_SIZE] = value;
+    writes++;
+    ArduinoSimulator::advance(EEPROM_WRITE_TIME_IN_US);
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+    HalScope scope;
+    byteTime = 10000000000ULL / baud;
+    busyUntil = ArduinoSimulator::getTime();
+}
+
+size_t HardwareSerial::write(uint8_t value) {
+    HalScope scope;
+    uint64_t start;
+    ArduinoSimulator::chargeCall();
+    if (availableForWrite() == 0) {
+        ArduinoSimulator::advanceTo(busyUntil - (SERIAL_TX_BUFFER_SIZE - 1) * byteTime);
+    }
+    start = ArduinoSimulator::getTime();
+    busyUntil = (busyUntil > start ? busyUntil : start) + byteTime;
+    bytes++;
+    if (receiver != 0) {
+        receiver(value);
+    }
+    return 1;
+}
+
+int HardwareSerial::availableForWrite() {
+    uint64_t now = ArduinoSimulator::getTime();
+    uint64_t queued;
+    if (busyUntil <= now || byteTime == 0) {
+        return SERIAL_TX_BUFFER_SIZE;
+    }
+    queued = (busyUntil - now + byteTime - 1) / byteTime;
+    return queued >= SERIAL_TX_BUFFER_SIZE ? 0 : (int) (SERIAL_TX_BUFFER_SIZE - queued);
+}
+
+void HardwareSerial::flush() {
+    HalScope scope;
+    if (busyUntil > ArduinoSimulator::getTime()) {
+        ArduinoSimulator::advanceTo(busyUntil);
+    }
+}
+
+#endif /* __ARDUINO_HOST_ARDUINO_SIMULATOR_CPP__ */
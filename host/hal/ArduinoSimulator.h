@@ -0,0 +1,230 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * ArduinoSimulator.h
+ * 
+ * Virtual clock and simulated TCS230 sensors behind the host Arduino HAL.
+ * 
+ * Time only moves forward when the code under test calls something that
+ * takes time on a real board (delay, pulseIn, digitalRead, micros...) or
+ * when the host explicitly advances it. While time advances, every pending
+ * external interrupt edge and TimerOne overflow is dispatched in order, so
+ * the drivers run their ISRs exactly as on the target.
+ * 
+ * Timer1 runs either the TimerOne library or, when its registers are set
+ * up for it, the input capture on SIMULATOR_ICP1_PIN at F_CPU, with the 
+ * overflow interrupt. The captures count as external interrupts, and the
+ * overflows as timer interrupts.
+ * 
+ * Each simulated sensor produces a 50% duty cycle square wave whose
+ * frequency depends on the S2/S3 (photodiode) and S0/S1 (scaling) pins it is
+ * wired to. After any transition of S0..S3 or OE, the output stays LOW for
+ * one period of the new frequency plus 1 us, like the real device.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_ARDUINO_SIMULATOR_H__
+#define __ARDUINO_HOST_ARDUINO_SIMULATOR_H__ 1
+
+#include <stdint.h>
+
+/**
+ * Marks a sensor input as not wired to the board.
+ */
+#define SIMULATOR_NOT_WIRED         0xff
+
+/**
+ * Maximum number of simulated sensors.
+ */
+#define SIMULATOR_MAX_SENSORS       8
+
+/**
+ * The pin the Timer1 input capture timestamps the rising edges of.
+ */
+#define SIMULATOR_ICP1_PIN          8
+
+/**
+ * Number of simulated digital pins.
+ */
+#define SIMULATOR_PINS              70
+
+class ArduinoSimulator {
+public:
+
+    /**
+     * Whose code the host CPU is running, for the cycle accounting.
+     */
+    enum Account {
+        HOST_ACCOUNT, HAL_ACCOUNT, DRIVER_ACCOUNT
+    };
+
+    /**
+     * Photodiode enumeration, in the drivers filter order.
+     */
+    enum Photodiode {
+        RED_PHOTODIODE, GREEN_PHOTODIODE, BLUE_PHOTODIODE, CLEAR_PHOTODIODE
+    };
+
+    /**
+     * Resets the clock, the pins, the sensors and the counters.
+     */
+    static void reset();
+
+    /**
+     * Wires a simulated sensor to the board.
+     * 
+     * When S0 and S1 are not wired the sensor is fixed at 2% scaling. When OE
+     * is not wired the sensor is always enabled.
+     * 
+     * @param outPin        The pin the sensor OUT is wired to.
+     * @param s2Pin         The pin the sensor S2 is wired to.
+     * @param s3Pin         The pin the sensor S3 is wired to.
+     * @param s0Pin         The pin the sensor S0 is wired to.
+     * @param s1Pin         The pin the sensor S1 is wired to.
+     * @param oePin         The pin the sensor OE is wired to.
+     * @return              The sensor index.
+     */
+    static unsigned char addSensor(unsigned char outPin, unsigned char s2Pin, unsigned char s3Pin,
+            unsigned char s0Pin = SIMULATOR_NOT_WIRED, unsigned char s1Pin = SIMULATOR_NOT_WIRED,
+            unsigned char oePin = SIMULATOR_NOT_WIRED);
+
+    /**
+     * Sets the full scale (100%) output frequency of each photodiode.
+     * 
+     * @param sensor        The sensor index.
+     * @param red           The red photodiode frequency, in Hz.
+     * @param green         The green photodiode frequency, in Hz.
+     * @param blue          The blue photodiode frequency, in Hz.
+     * @param clear         The clear photodiode frequency, in Hz.
+     */
+    static void setFrequencies(unsigned char sensor, double red, double green, double blue, double clear);
+
+    /**
+     * Sets the frequencies of a sensor at a later virtual time, as when the
+     * color in front of it changes. Only one change is pending at a time.
+     * 
+     * @param nanoseconds   The absolute time of the change.
+     * @param sensor        The sensor index.
+     * @param red           The red photodiode frequency, in Hz.
+     * @param green         The green photodiode frequency, in Hz.
+     * @param blue          The blue photodiode frequency, in Hz.
+     * @param clear         The clear photodiode frequency, in Hz.
+     */
+    static void scheduleFrequencies(uint64_t nanoseconds, unsigned char sensor, double red, double green,
+            double blue, double clear);
+
+    /**
+     * Sets how much virtual time a call to digitalRead, micros or millis
+     * takes outside an interrupt.
+     * 
+     * @param nanoseconds   The cost of each call.
+     */
+    static void setCallCost(unsigned long nanoseconds);
+
+    /**
+     * Advances the virtual clock, dispatching the interrupts on the way.
+     * 
+     * @param microseconds  How much to advance.
+     */
+    static void advance(unsigned long microseconds);
+
+    /**
+     * Advances the virtual clock up to the given time.
+     * 
+     * @param nanoseconds   The absolute time to reach.
+     */
+    static void advanceTo(uint64_t nanoseconds);
+
+    /**
+     * Returns the virtual time in nanoseconds.
+     */
+    static uint64_t getTime();
+
+    /**
+     * Returns the level of a pin at the current time.
+     */
+    static unsigned char getLevel(unsigned char pin);
+
+    /**
+     * Returns when the given pin reaches the given level, starting now.
+     * 
+     * @return              The time in nanoseconds, or UINT64_MAX if never.
+     */
+    static uint64_t getNextTransition(unsigned char pin, unsigned char level);
+
+    /**
+     * Returns how many external interrupts were dispatched since reset.
+     */
+    static unsigned long getExternalInterrupts();
+
+    /**
+     * Returns how many timer interrupts were dispatched since reset.
+     */
+    static unsigned long getTimerInterrupts();
+
+    /**
+     * Returns how many times pulseIn was called since reset.
+     */
+    static unsigned long getPulseInCalls();
+
+    /**
+     * Returns how many times digitalRead found a pin HIGH that it read LOW
+     * the time before, since reset. It counts the rising edges seen by the
+     * drivers that poll a pin.
+     */
+    static unsigned long getRisingReads();
+
+    /**
+     * Starts charging the host CPU cycles to the given account, until the
+     * matching leave().
+     * 
+     * The HAL charges its own code to HAL_ACCOUNT and the interrupt handlers
+     * to DRIVER_ACCOUNT. The benchmarks wrap the driver calls with
+     * DRIVER_ACCOUNT, so the cycles spent by the driver itself are measured
+     * apart from the simulation.
+     * 
+     * @param account       The account to charge.
+     */
+    static void enter(Account account);
+
+    /**
+     * Goes back to charging the previous account.
+     */
+    static void leave();
+
+    /**
+     * Returns the host CPU cycles charged to an account since reset. On x86
+     * they are time stamp counter ticks, elsewhere nanoseconds.
+     * 
+     * @param account       The account.
+     */
+    static uint64_t getCycles(Account account);
+
+    /**
+     * Returns whether an interrupt handler is running.
+     */
+    static bool isInInterrupt();
+
+    /**
+     * Charges the cost of a call, when outside an interrupt.
+     */
+    static void chargeCall();
+
+    /**
+     * Called by the HAL when a pin is written.
+     */
+    static void pinWritten(unsigned char pin, unsigned char value);
+
+    /**
+     * Called by the HAL when an interrupt is attached or detached.
+     */
+    static void setInterrupt(unsigned char interruptNumber, void (*isr)(void), int mode);
+
+    /**
+     * Called by the HAL when the TimerOne schedule changes.
+     */
+    static void timerChanged();
+};
+
+#endif /* __ARDUINO_HOST_ARDUINO_SIMULATOR_H__ */
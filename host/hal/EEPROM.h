@@ -0,0 +1,46 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * EEPROM.h
+ * 
+ * Host-side replacement for the EEPROM library. The memory is kept in RAM
+ * and, like the real one, survives ArduinoSimulator::reset().
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_EEPROM_H__
+#define __ARDUINO_HOST_EEPROM_H__ 1
+
+/**
+ * The simulated EEPROM size, in bytes (the ATmega328P one).
+ */
+#define EEPROM_SIZE 1024
+
+class EEPROMClass {
+public:
+
+    /**
+     * The memory, erased (0xff) at start up.
+     */
+    unsigned char data[EEPROM_SIZE];
+
+    /**
+     * How many bytes were written.
+     */
+    unsigned long writes;
+
+    EEPROMClass();
+
+    unsigned char read(int address);
+
+    void write(int address, unsigned char value);
+
+    unsigned int length() {
+        return EEPROM_SIZE;
+    }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif /* __ARDUINO_HOST_EEPROM_H__ */
@@ -0,0 +1,64 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * HardwareSerial.h
+ * 
+ * Host-side replacement for the serial port. Each byte takes 10 bit times
+ * of the virtual clock, behind a transmit buffer like the one of the AVR 
+ * core, so a write blocks while the buffer is full. The bytes are handed to
+ * the receiver callback, the PC side of the link.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_HARDWARE_SERIAL_H__
+#define __ARDUINO_HOST_HARDWARE_SERIAL_H__ 1
+
+#include <Print.h>
+
+/**
+ * The transmit buffer size, in bytes (the AVR core one).
+ */
+#define SERIAL_TX_BUFFER_SIZE 64
+
+class HardwareSerial: public Print {
+public:
+
+    /**
+     * The time each byte takes, in nanoseconds. 0 until begin().
+     */
+    uint64_t byteTime;
+
+    /**
+     * When the last byte in the transmit buffer is sent, in nanoseconds.
+     */
+    uint64_t busyUntil;
+
+    /**
+     * How many bytes were written.
+     */
+    unsigned long bytes;
+
+    /**
+     * The PC side of the link, NULL to drop the bytes.
+     */
+    void (*receiver)(uint8_t value);
+
+    HardwareSerial()
+            : byteTime(0), busyUntil(0), bytes(0), receiver(0) {
+    }
+
+    void begin(unsigned long baud);
+
+    size_t write(uint8_t value);
+
+    int availableForWrite();
+
+    void flush();
+
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif /* __ARDUINO_HOST_HARDWARE_SERIAL_H__ */
@@ -0,0 +1,39 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * Print.h
+ * 
+ * Host-side replacement for the Print class of the Arduino core. Only the
+ * binary writes are declared.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_PRINT_H__
+#define __ARDUINO_HOST_PRINT_H__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Print {
+public:
+
+    virtual ~Print() {
+    }
+
+    virtual size_t write(uint8_t value) = 0;
+
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size-- > 0 && write(*buffer++) == 1) {
+            n++;
+        }
+        return n;
+    }
+
+    virtual int availableForWrite() {
+        return 0;
+    }
+};
+
+#endif /* __ARDUINO_HOST_PRINT_H__ */
@@ -0,0 +1,56 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * TimerOne.h
+ * 
+ * Host-side replacement for the TimerOne library. The timer runs on the
+ * virtual clock of the ArduinoSimulator.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_TIMER_ONE_H__
+#define __ARDUINO_HOST_TIMER_ONE_H__ 1
+
+class TimerOne {
+public:
+
+    /**
+     * The attached interrupt handler.
+     */
+    void (*isrCallback)();
+
+    /**
+     * The current period, in microseconds.
+     */
+    unsigned long period;
+
+    /**
+     * Whether the timer is counting.
+     */
+    bool running;
+
+    TimerOne()
+            : isrCallback(0), period(1000000), running(false) {
+    }
+
+    void initialize(long microseconds = 1000000);
+
+    void setPeriod(long microseconds);
+
+    void attachInterrupt(void (*isr)(), long microseconds = -1);
+
+    void detachInterrupt();
+
+    void start();
+
+    void stop();
+
+    void restart();
+
+    void resume();
+};
+
+extern TimerOne Timer1;
+
+#endif /* __ARDUINO_HOST_TIMER_ONE_H__ */
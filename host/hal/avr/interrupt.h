@@ -0,0 +1,22 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * avr/interrupt.h
+ * 
+ * Host-side replacement for the AVR interrupt macros. The vectors become
+ * plain functions, which the simulator calls for the Timer1 ones.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_AVR_INTERRUPT_H__
+#define __ARDUINO_HOST_AVR_INTERRUPT_H__ 1
+
+#include <Arduino.h>
+
+#define ISR(vector) void vector()
+
+#define cli() noInterrupts()
+#define sei() interrupts()
+
+#endif /* __ARDUINO_HOST_AVR_INTERRUPT_H__ */
@@ -0,0 +1,39 @@
+/**
+ * Arduino - Color Recognition Sensor
+ * 
+ * avr/io.h
+ * 
+ * Host-side replacement for the AVR registers. It only declares the Timer1
+ * registers of the input capture driver, as plain variables, which the 
+ * simulator reads to run the input capture.
+ * 
+ * @author Dalmir da Silva <dalmirdasilva@gmail.com>
+ */
+
+#ifndef __ARDUINO_HOST_AVR_IO_H__
+#define __ARDUINO_HOST_AVR_IO_H__ 1
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000L
+#endif
+
+#define _BV(bit) (1 << (bit))
+
+#define CS10    0
+#define ICES1   6
+#define ICNC1   7
+#define TOV1    0
+#define ICF1    5
+#define TOIE1   0
+#define ICIE1   5
+
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint8_t TIFR1;
+extern volatile uint8_t TIMSK1;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t ICR1;
+
+#endif /* __ARDUINO_HOST_AVR_IO_H__ */